@@ -0,0 +1,27 @@
+#pragma once
+
+// Player input, produced by Visualisation and applied by Gameplay.
+enum class Action
+{
+    Exit,
+    // fixme: North, West, etc. names are stupid in this case
+    MoveNorth,
+    MoveSouth,
+    MoveWest,
+    MoveEast,
+    RotateForward,
+    RotateBackward,
+    RotatetLeft,
+    RotatetRight,
+    StartBoost,
+    StopBoost,
+    HardDrop,
+    ReportTimings
+};
+
+struct TimedAction
+{
+    Action action;
+    // when the input happened, in Simulation::Now() seconds
+    float time;
+};
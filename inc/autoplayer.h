@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "action.h"
+#include "board.h"
+#include "gameplay.h"
+#include "log.h"
+#include "thread_pool.h"
+
+// Plays the game through the same actions a human uses, for soak tests and attract
+// mode. For every new block it searches all the orientations and cells the block can
+// be rotated and moved to from where it is, drops it there on a copy of the heap and
+// scores the resulting heap. The placements are scored in parallel on a thread pool.
+//
+// Most placements don't complete a layer, those are scored from the column heights of
+// the heap and the column profile of the block without touching a copy of the heap.
+class Autoplayer
+{
+  public:
+    // 0 threads picks one per core
+    explicit Autoplayer(int threads = 0);
+
+    // Fills `actions` with the ones taking the falling block of `state` to the best
+    // placement, ending with a hard drop, or none if the block can't move. They are
+    // meant to be handed to Gameplay::HandleAction right away, while the block is still
+    // at the height it was planned for. Reusing `actions` keeps planning allocation free.
+    void Plan(const GameSnapshot &state, std::vector<Action> &actions);
+
+  private:
+    struct Candidate
+    {
+        int orientation;
+        int x;
+        int z;
+    };
+
+    // What the score looks at, of the heap or of the heap with a candidate dropped in.
+    struct Surface
+    {
+        int width = 0;
+        // also the cells of a full layer
+        int columns = 0;
+        std::vector<int> tops;
+        std::vector<int> layer_cells;
+        int sum = 0;
+        int sum_squares = 0;
+        int occupied = 0;
+    };
+
+    // One column of a block orientation with cells in it.
+    struct BlockColumn
+    {
+        int x;
+        int z;
+        // height above the bottom of the block
+        int top;
+        int cells;
+    };
+
+    struct Profile
+    {
+        std::vector<BlockColumn> columns;
+        std::array<int, BLOCK_SIZE> layer_cells;
+    };
+
+    // How a cell or an orientation was first reached in the search: the action and the
+    // index it was taken from, -1 for the start and unreached ones.
+    struct Step
+    {
+        Action action;
+        int from;
+    };
+
+    ThreadPool pool_;
+    // heap copies to drop the candidates on, one per pool thread
+    std::vector<Board> scratch_;
+
+    // search state, reused between the plans to avoid allocations
+    std::vector<Placement> placements_;
+    std::vector<uint64_t> collisions_;
+    CollisionScratch collision_scratch_;
+    // orientations in the order they were reached
+    std::vector<int> queue_;
+    std::vector<bool> reached_;
+    std::vector<Step> rotations_;
+    std::vector<Step> moves_;
+    std::vector<Candidate> candidates_;
+    std::vector<float> scores_;
+    // of every ShapeTable orientation
+    std::vector<Profile> profiles_;
+    Surface surface_;
+    std::vector<Surface> scratch_surfaces_;
+
+    Log log_{"Autoplayer"};
+
+    static void Measure(const Board &heap, Surface &surface);
+    // Lower is better. `removed` layers were cleared by the block landing at `landing`.
+    static float Score(const Surface &surface, int removed, int landing);
+    // Scores the block landing at `landing` on the heap described by surface_, fails if
+    // it completes a layer.
+    bool ScoreDrop(const Profile &profile, int offset_x, int offset_z, int landing,
+                   float &score) const;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Packed occupancy mask of a single Geometry layer. Bit (z * W + x) is set when the
+// cell (x, z) is occupied, so a 5x5 block layer fits in one word and a 10x10 board
+// layer in two.
+template <int BITS> class Bitplane
+{
+  public:
+    static constexpr int WORDS = (BITS + 63) / 64;
+
+    bool Test(int i) const { return (words_[i / 64] >> (i % 64)) & 1; }
+    void Set(int i) { words_[i / 64] |= uint64_t(1) << (i % 64); }
+    void Reset(int i) { words_[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+    void Clear() { words_.fill(0); }
+
+    // Returns `count` (at most 64) consecutive bits starting at bit `pos`.
+    uint64_t Extract(int pos, int count) const
+    {
+        int word = pos / 64, shift = pos % 64;
+        uint64_t ret = words_[word] >> shift;
+
+        if (shift != 0 && shift + count > 64 && word + 1 < WORDS)
+            ret |= words_[word + 1] << (64 - shift);
+
+        return count == 64 ? ret : ret & ((uint64_t(1) << count) - 1);
+    }
+
+    // ORs `bits` into the mask starting at bit `pos`.
+    void Deposit(int pos, uint64_t bits)
+    {
+        int word = pos / 64, shift = pos % 64;
+        words_[word] |= bits << shift;
+
+        if (shift != 0 && word + 1 < WORDS)
+            words_[word + 1] |= bits >> (64 - shift);
+    }
+
+    bool Any() const
+    {
+        for (auto word : words_)
+            if (word)
+                return true;
+        return false;
+    }
+
+    bool operator==(const Bitplane &other) const { return words_ == other.words_; }
+    bool operator!=(const Bitplane &other) const { return words_ != other.words_; }
+
+    // Mask with all BITS cells occupied.
+    static Bitplane Full()
+    {
+        Bitplane ret;
+        for (int i = 0; i < BITS; i++)
+            ret.Set(i);
+        return ret;
+    }
+
+  private:
+    std::array<uint64_t, WORDS> words_{};
+};
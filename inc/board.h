@@ -0,0 +1,55 @@
+#pragma once
+
+#include "geometry.h"
+#include "shapes.h"
+
+#include <boost/variant.hpp>
+
+// The heap, with its size picked at runtime. Every call is dispatched once to one of
+// the precompiled Geometry specializations below, so the collision code keeps its
+// compile-time sizes. A size without its own specialization runs on the next larger
+// one with a reduced extent.
+class Board
+{
+  public:
+    typedef boost::variant<Geometry<6, 6>, Geometry<8, 8>, Geometry<10, 10>,
+                           Geometry<12, 12>, Geometry<16, 16>, Geometry<32, 32>>
+        Variant;
+
+    // of the largest specialization
+    static const int MAX_SIZE = 32;
+
+    explicit Board(int size);
+
+    int Size() const { return size_; }
+    int Layers() const;
+
+    void Reserve(int layers);
+    void AddFullLayer();
+    void Repaint(uint32_t r, uint32_t g, uint32_t b);
+
+    bool CheckCollision(const BlockGeometry &block, int offset_x, int offset_z,
+                        int offset_height) const;
+    std::vector<uint64_t> CheckCollisions(const std::vector<BlockGeometry> &blocks,
+                                          const std::vector<Placement> &placements) const;
+    void CheckCollisions(const std::vector<BlockGeometry> &blocks,
+                         const std::vector<Placement> &placements,
+                         std::vector<uint64_t> &ret, CollisionScratch &scratch) const;
+    void Merge(const BlockGeometry &block, int offset_x, int offset_z, int offset_height,
+               uint8_t color);
+
+    bool CheckFullLayer(int layer) const;
+    int RemoveFullLayers(int from, int to);
+
+    int ColumnHeight(int x, int z) const;
+    int DropHeight(const BlockGeometry &block, int offset_x, int offset_z,
+                   int from_height) const;
+
+    // Calls f with the Geometry specialization in use.
+    template <typename F> auto Visit(F f) const { return boost::apply_visitor(f, geometry_); }
+    template <typename F> auto Visit(F f) { return boost::apply_visitor(f, geometry_); }
+
+  private:
+    int size_;
+    Variant geometry_;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "log.h"
+
+// Sub-allocates ranges of a few large GL buffers, so objects don't create and delete
+// buffer names every time their mesh changes. Pages are persistently mapped when the
+// context supports ARB_buffer_storage and written through glBufferSubData otherwise.
+//
+// Ranges are treated as immutable once drawn: an update goes to a fresh range and the
+// old one is only reused after the GPU is done with the frames that could read it.
+class BufferPool
+{
+  public:
+    struct Range
+    {
+        GLuint buffer = 0;
+        size_t offset = 0;
+        size_t size = 0;
+        int page = -1;
+    };
+
+    explicit BufferPool(size_t page_size);
+    ~BufferPool();
+
+    BufferPool(const BufferPool &) = delete;
+    void operator=(const BufferPool &) = delete;
+
+    // The offset of the range is a multiple of `element`, so it can be addressed with
+    // a base vertex from the start of its buffer.
+    Range Allocate(size_t size, size_t element = 1);
+    // Returns the range to the pool once the frames issued so far are finished, the
+    // range is reset.
+    void Free(Range &range);
+
+    void Write(const Range &range, size_t offset, const void *data, size_t size);
+    // Copies the first `size` bytes between ranges on the GPU side.
+    void Copy(const Range &from, const Range &to, size_t size);
+
+    // Fences the frame's draws and releases ranges freed before finished frames.
+    void EndFrame();
+
+  private:
+    struct Page
+    {
+        GLuint buffer;
+        size_t size;
+        // persistent mapping, nullptr if unsupported
+        char *mapped;
+        // offset -> size of the free ranges
+        std::map<size_t, size_t> free;
+    };
+
+    struct Fence
+    {
+        uint64_t frame;
+        GLsync sync;
+    };
+
+    const size_t page_size_;
+    const bool persistent_;
+
+    std::vector<Page> pages_;
+
+    uint64_t frame_;
+    std::deque<Fence> fences_;
+    std::deque<std::pair<uint64_t, Range>> retired_;
+
+    Log log_{"BufferPool"};
+
+    void Release(const Range &range);
+};
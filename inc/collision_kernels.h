@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+// One occupied row of a block. `offset` is the index of the row in the board row table
+// (layer * board depth + z) when the block is placed at the origin.
+struct PieceRow
+{
+    int32_t offset;
+    uint32_t bits;
+};
+
+// Tests `count` placements of a single block against a table of board rows. The block
+// rows of the placement i land at rows[base[i] + row.offset], shifted by shift[i] cells
+// (negative means towards x = 0). Sets hits[i] to 1 if any of the rows overlap.
+//
+// Placements have to be validated against the board bounds by the caller, the kernel
+// only does the overlap test. Picks an AVX2 implementation at runtime when the CPU
+// supports it.
+void CheckRowCollisions(const uint32_t *rows, const PieceRow *piece, int piece_rows,
+                        const int32_t *base, const int32_t *shift, int count,
+                        uint8_t *hits);
+
+// Name of the implementation picked by CheckRowCollisions, for logging.
+const char *RowCollisionKernelName();
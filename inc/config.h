@@ -6,6 +6,7 @@
 #include <map>
 #include <pugixml.hpp>
 #include <string>
+#include <vector>
 
 class Config
 {
@@ -28,8 +29,15 @@ class Config
 
     void Load(std::string config_path);
     void Load(int argc, char **argv);
+    // one --name=value argument
+    void LoadArgument(const std::string &argument);
+
+    // Every option as a --name=value argument.
+    std::vector<std::string> Arguments() const;
 
     void SetParameter(std::string name, boost::any val);
+    // Logs an error and fails if the int option `name` is outside [min, max].
+    bool CheckRange(const std::string &name, int min, int max);
     void DumpSettings();
 
     template <typename T> T GetOption(std::string name)
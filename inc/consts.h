@@ -1,5 +1,4 @@
 
 #pragma once
 
-#define BLOCK_SIZE 5
-#define BOARD_SIZE 10
\ No newline at end of file
+#define BLOCK_SIZE 5
\ No newline at end of file
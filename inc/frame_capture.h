@@ -0,0 +1,65 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "log.h"
+#include "video_writer.h"
+
+// Records the rendered frames into a video without stalling the render thread.
+// glReadPixels only queues a copy into one of a ring of pixel buffer objects. The
+// buffer is mapped a few frames later once its fence has signaled, and the pixels
+// are converted and written to disk on a writer thread. Frames are dropped, not
+// waited for, when the GPU or the disk can't keep up.
+class FrameCapture
+{
+  public:
+    FrameCapture(const std::string &path, int width, int height, int fps);
+    // Waits for the frames in flight and finishes the file.
+    ~FrameCapture();
+
+    // Reads back the back buffer, call after drawing and before the swap.
+    void Capture();
+
+  private:
+    static const int RING = 3;
+    // frames converted or written at once, more are dropped
+    static const int MAX_QUEUED = 8;
+
+    const int width_;
+    const int height_;
+    const size_t frame_size_;
+
+    struct Slot
+    {
+        GLuint pbo;
+        GLsync fence;
+    };
+    std::array<Slot, RING> slots_;
+    // slots waiting for the GPU, oldest first
+    std::deque<int> in_flight_;
+    int next_slot_;
+    uint64_t dropped_;
+
+    // Maps the slot and hands its pixels over to the writer.
+    void Collect(int index);
+
+    VideoWriter writer_;
+    std::mutex frames_mutex_;
+    std::condition_variable frames_cv_;
+    std::deque<std::unique_ptr<std::vector<uint8_t>>> frames_;
+    std::vector<std::unique_ptr<std::vector<uint8_t>>> free_frames_;
+    int allocated_frames_;
+    bool writer_stop_;
+    std::thread writer_thread_;
+
+    void RunWriter();
+
+    Log log_{"FrameCapture"};
+};
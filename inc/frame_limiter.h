@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+
+// Holds a loop to a target rate without busy-waiting the whole frame. Sleeps overshoot
+// by up to a scheduler tick, so Wait() sleeps until shortly before the deadline and
+// spins the rest. The margin follows the overshoot of the recent sleeps. How late
+// Wait() returns is recorded as the "limiter overshoot" timing of the Profiler.
+class FrameLimiter
+{
+  public:
+    // 0 fps doesn't limit anything
+    explicit FrameLimiter(int fps);
+
+    // Returns at the start of the next frame.
+    void Wait();
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    const Clock::duration period_;
+    Clock::time_point next_;
+    // how long before the deadline sleeping stops
+    Clock::duration margin_;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "gameplay.h"
+#include "visualisation.h"
+
+#include <vector>
+
+// Presents GameSnapshots published by the simulation with Visualisation objects.
+// Render thread only.
+class GameView
+{
+  public:
+    GameView(Visualisation &vis);
+
+    // Shows the state `alpha` of the way from `previous` to `current`.
+    void Show(const GameSnapshot &previous, const GameSnapshot &current, float alpha);
+
+  private:
+    // one object per shape
+    std::vector<Visualisation::Object *> blocks_;
+    Visualisation::Object *heap_object_;
+
+    int shown_shape_;
+    int shown_heap_version_;
+};
@@ -1,29 +1,71 @@
 
 #pragma once
 
+#include "action.h"
+#include "board.h"
 #include "consts.h"
 #include "geometry.h"
-#include "visualisation.h"
+#include "log.h"
+#include "shapes.h"
+#include "trajectory.h"
 
 #include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <memory>
 #include <random>
 
+// Immutable state of the game at one simulation step, everything the renderer needs
+// to draw it.
+struct GameSnapshot
+{
+    float time = 0.0f;
+    bool game_over = false;
+
+    // changes with every spawned block, consecutive snapshots of the same block can be
+    // interpolated
+    int block_serial = 0;
+    // layers cleared so far
+    int layers_cleared = 0;
+    int block_shape = 0;
+    glm::vec3 block_position;
+    glm::quat block_orientation;
+    glm::vec3 block_color;
+    // where the block is headed, for controllers: ShapeTable orientation and the
+    // offset of the cell it moves to (block_position.y is its offset height)
+    int block_orientation_index = 0;
+    int block_x = 0;
+    int block_z = 0;
+
+    // landing preview
+    bool ghost_visible = false;
+    glm::vec3 ghost_position;
+
+    // changes with every modification of the heap
+    int heap_version = 0;
+    std::shared_ptr<const Board> heap;
+};
+
 class Gameplay
 {
   public:
-    Gameplay(Visualisation &vis);
+    // The same seed, options and actions give the same game, see Replay.
+    explicit Gameplay(uint32_t seed);
+
+    // The seed option, or a random seed when it is 0.
+    static uint32_t NewSeed();
 
     // returns if the game should continue
     bool Update(float running_time);
 
-    void HandleAction(Visualisation::Action action, float running_time);
+    void HandleAction(Action action, float running_time);
+
+    // state after the last Update
+    const GameSnapshot &State() const { return state_; }
 
   private:
-    std::vector<std::pair<Geometry<BLOCK_SIZE, BLOCK_SIZE>, Visualisation::Object *>>
-        blocks_;
+    GameSnapshot state_;
 
-    Geometry<BOARD_SIZE, BOARD_SIZE> heap_;
-    Visualisation::Object *heap_object_;
+    Board heap_;
 
     struct
     {
@@ -32,13 +74,15 @@ class Gameplay
 
         float height_ = 0;
         int type = 0;
-        Geometry<BLOCK_SIZE, BLOCK_SIZE> geometry_;
+        // index into ShapeTable
+        int orientation_ = 0;
+        // Palette index
+        uint8_t color_ = 0;
     } falling_block_;
 
     float last_time_;
     bool boost_on_;
 
-    std::random_device random_device_;
     std::mt19937 random_generator_;
     std::uniform_int_distribution<> color_distribution_;
     std::uniform_int_distribution<> block_distribution_;
@@ -46,6 +90,12 @@ class Gameplay
     Trajectory trajectory_movement_x_;
     Trajectory trajectory_movement_z_;
 
+    // rotation animation of the falling block
+    glm::quat target_rot_;
+    glm::quat initial_rot_;
+    glm::quat current_rot_;
+    Trajectory trajectory_rot_;
+
     float accumulated_speed_;
     const float max_speed_;
     const float boost_speed_;
@@ -56,4 +106,10 @@ class Gameplay
     Log log_{"Gameplay"};
 
     void InitNewFallingBlock();
+    void PublishHeap();
+    const BlockGeometry &FallingGeometry() const;
+    // offset height the falling block would come to rest at
+    int LandingHeight() const;
+    void TryRotate(BlockGeometry::RotationDirection dir, float angle, glm::vec3 axis,
+                   float running_time);
 };
\ No newline at end of file
@@ -1,85 +1,371 @@
 #pragma once
 
+#include "bitplane.h"
+#include "collision_kernels.h"
 #include "exceptions.h"
+#include "palette.h"
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <vector>
+
+// Pose of a block for Geometry::CheckCollisions, orientation indexes the list of block
+// geometries passed along.
+struct Placement
+{
+    int x;
+    int z;
+    int height;
+    int orientation;
+};
+
+// Hands out the stamps of the layers of one geometry: every change of a layer stamps
+// it with a new value. Two layers with the same stamp have the same content, even
+// across copies of a geometry. The high half of a stamp numbers the source, so sources
+// count on their own and only take a number when they are created.
+class LayerStamps
+{
+  public:
+    LayerStamps() : next_(NextSource() << 32) {}
+    // A copy stamps its changes apart from the original, the stamps it copied along
+    // stay valid. Assigning keeps the own numbering for the same reason.
+    LayerStamps(const LayerStamps &) : LayerStamps() {}
+    LayerStamps &operator=(const LayerStamps &) { return *this; }
+
+    uint64_t Next() { return ++next_; }
+
+  private:
+    uint64_t next_;
+
+    static uint64_t NextSource()
+    {
+        static std::atomic<uint64_t> counter{0};
+        return ++counter;
+    }
+};
+
+// Working buffers of Geometry::CheckCollisions.
+struct CollisionScratch
+{
+    // occupied rows and bounding box of every block
+    struct Footprint
+    {
+        std::vector<PieceRow> rows;
+        int min_x, max_x, min_z, max_z;
+        int min_h, max_h;
+    };
+
+    std::vector<Footprint> footprints;
+    std::vector<uint32_t> rows;
+    // placements per block that need the row kernel
+    std::vector<std::vector<int>> buckets;
+    std::vector<int32_t> base, shift;
+    std::vector<uint8_t> hits;
+};
 
 template <int W, int H> class Geometry
 {
+    static_assert(W <= 32, "Rows of a layer must fit in a single occupancy word");
+
   public:
-    std::vector<std::array<uint32_t, W * H>> heap_;
+    // cells hold Palette indices
+    typedef std::array<uint8_t, W * H> Layer;
+    typedef Bitplane<W * H> Plane;
+
+    Geometry() : width_(W), depth_(H), full_(Plane::Full()) {}
+
+    // Limits the usable part of the geometry to width x depth cells, the cells outside
+    // of it behave like the walls around the geometry. Lets a larger specialization
+    // stand in for sizes that don't have their own. Call it before adding layers.
+    void SetExtent(int width, int depth)
+    {
+        ASSERT(width <= W && depth <= H && Layers() == 0);
+        width_ = width;
+        depth_ = depth;
+
+        full_.Clear();
+        for (int z = 0; z < depth_; z++)
+            full_.Deposit(z * W, (uint64_t(1) << width_) - 1);
+    }
+
+    int Width() const { return width_; }
+    int Depth() const { return depth_; }
+
+    int Layers() const { return int(order_.size()); }
 
-    uint32_t &Element(int x, int z, int h) { return heap_[h][z * W + x]; }
+    const uint8_t &Element(int x, int z, int h) const
+    {
+        return slots_[order_[h]].cells[z * W + x];
+    }
+
+    void SetElement(int x, int z, int h, uint8_t value)
+    {
+        auto &slot = slots_[order_[h]];
+        slot.cells[z * W + x] = value;
+        slot.stamp = stamps_.Next();
+        if (value)
+        {
+            slot.occupancy.Set(z * W + x);
+            tops_[z * W + x] = std::max(tops_[z * W + x], h + 1);
+        }
+        else
+        {
+            slot.occupancy.Reset(z * W + x);
+            if (tops_[z * W + x] == h + 1)
+                tops_[z * W + x] = FindTop(z * W + x, h);
+        }
+    }
+
+    // Number of layers up to the highest occupied cell of the column (x, z).
+    int ColumnHeight(int x, int z) const { return tops_[z * W + x]; }
+
+    // Changes with every modification of the layer, used to find out which layers have
+    // to be redrawn. Never zero.
+    uint64_t LayerStamp(int h) const { return slots_[order_[h]].stamp; }
+
+    // Occupancy of the row z of the layer h, bit x set for every occupied cell.
+    uint32_t Row(int z, int h) const
+    {
+        return uint32_t(slots_[order_[h]].occupancy.Extract(z * W, W));
+    }
+
+    // Preallocates storage, growing up to `layers` layers won't allocate.
+    void Reserve(int layers)
+    {
+        slots_.reserve(layers);
+        order_.reserve(layers);
+        free_.reserve(layers);
+    }
+
+    void AddEmptyLayer()
+    {
+        auto &slot = slots_[AllocateSlot()];
+        slot.cells.fill(0);
+        slot.occupancy.Clear();
+    }
 
-    void AddEmptyLayer() { heap_.emplace_back(); }
     void AddFullLayer()
     {
-        std::array<uint32_t, W * H> layer;
-        layer.fill(1);
-        heap_.push_back(layer);
+        auto &slot = slots_[AllocateSlot()];
+        slot.cells.fill(0);
+        slot.occupancy = full_;
+
+        for (int z = 0; z < depth_; z++)
+        {
+            for (int x = 0; x < width_; x++)
+            {
+                slot.cells[z * W + x] = 1;
+                tops_[z * W + x] = Layers();
+            }
+        }
     }
 
-    void AddLayer(std::array<uint32_t, W * H> layer) { heap_.emplace_back(layer); }
+    void AddLayer(const Layer &layer)
+    {
+        auto &slot = slots_[AllocateSlot()];
+        slot.cells = layer;
+        slot.occupancy.Clear();
+
+        for (int i = 0; i < W * H; i++)
+        {
+            if (layer[i])
+            {
+                slot.occupancy.Set(i);
+                tops_[i] = Layers();
+            }
+        }
+    }
 
+    // Copies the occupied cells of other into this geometry. If color (a palette index)
+    // is given it replaces the colors of the merged cells.
     template <int OTHER_W, int OTHER_H>
-    void Merge(Geometry<OTHER_W, OTHER_H> &other, int offset_x, int offset_z,
-               int offset_height)
+    void Merge(const Geometry<OTHER_W, OTHER_H> &other, int offset_x, int offset_z,
+               int offset_height, uint8_t color = 0)
     {
-        for (unsigned int h = 0; h < other.heap_.size(); h++)
+        int top = other.Layers() - 1;
+        while (top >= 0 && !other.Occupancy(top).Any())
+            top--;
+
+        while (top + offset_height >= Layers())
+            AddEmptyLayer();
+
+        for (int h = 0; h <= top; h++)
         {
-            for (unsigned int x = 0; x < OTHER_W; x++)
+            if (!other.Occupancy(h).Any() || h + offset_height < 0)
+                continue;
+
+            for (int z = 0; z < OTHER_H; z++)
             {
-                for (unsigned int z = 0; z < OTHER_H; z++)
-                {
-                    if (x + offset_x < 0 || x + offset_x >= W)
-                        continue;
-                    if (z + offset_z < 0 || z + offset_z >= H)
-                        continue;
-                    if (h + offset_height < 0)
-                        continue;
+                if (z + offset_z < 0 || z + offset_z >= depth_)
+                    continue;
+
+                // cells falling outside of the board are dropped
+                uint64_t row = ClipRow(other.Row(z, h), offset_x, width_);
+                if (!row)
+                    continue;
 
-                    while (h + offset_height >= heap_.size())
-                        AddEmptyLayer();
+                auto &slot = slots_[order_[h + offset_height]];
+                slot.occupancy.Deposit((z + offset_z) * W, row);
+                slot.stamp = stamps_.Next();
 
-                    if (other.Element(x, z, h))
-                        Element(x + offset_x, z + offset_z, h + offset_height) =
-                            other.Element(x, z, h);
-                    
+                for (; row; row &= row - 1)
+                {
+                    int x = __builtin_ctzll(row);
+                    slot.cells[(z + offset_z) * W + x] =
+                        color ? color : other.Element(x - offset_x, z, h);
+                    tops_[(z + offset_z) * W + x] =
+                        std::max(tops_[(z + offset_z) * W + x], h + offset_height + 1);
                 }
             }
         }
     }
 
+    // Collisions are tested row by row: a row of the other geometry is shifted into
+    // the board coordinates and ANDed with the matching row of the layer.
+    template <int OTHER_W, int OTHER_H>
+    bool CheckCollision(const Geometry<OTHER_W, OTHER_H> &other, int offset_x,
+                        int offset_z, int offset_height) const
+    {
+        for (int h = 0; h < other.Layers(); h++)
+        {
+            if (!other.Occupancy(h).Any())
+                continue;
+
+            for (int z = 0; z < OTHER_H; z++)
+            {
+                uint64_t row = other.Row(z, h);
+                if (!row)
+                    continue;
+
+                uint64_t shifted;
+                if (z + offset_z < 0 || z + offset_z >= depth_ ||
+                    !ShiftRow(row, offset_x, width_, shifted) || h + offset_height < 0)
+                    return true;
+
+                if (h + offset_height >= Layers())
+                    continue;
+
+                if (Row(z + offset_z, h + offset_height) & shifted)
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Batched CheckCollision: bit i of the result is set if placements[i] collides.
+    // The board rows are laid out in a flat table once per call and all the placements
+    // of the same orientation are handed to the (vectorized) row kernel together.
     template <int OTHER_W, int OTHER_H>
-    bool CheckCollision(Geometry<OTHER_W, OTHER_H> &other, int offset_x, int offset_z,
-                        int offset_height)
+    std::vector<uint64_t>
+    CheckCollisions(const std::vector<Geometry<OTHER_W, OTHER_H>> &blocks,
+                    const std::vector<Placement> &placements) const
     {
-        for (unsigned int h = 0; h < other.heap_.size(); h++)
+        std::vector<uint64_t> ret;
+        CollisionScratch scratch;
+        CheckCollisions(blocks, placements, ret, scratch);
+        return ret;
+    }
+
+    // Same, for callers testing placements often: the result goes to `ret` and the
+    // working buffers live in `scratch`, both keep their capacity between calls.
+    template <int OTHER_W, int OTHER_H>
+    void CheckCollisions(const std::vector<Geometry<OTHER_W, OTHER_H>> &blocks,
+                         const std::vector<Placement> &placements,
+                         std::vector<uint64_t> &ret, CollisionScratch &scratch) const
+    {
+        ret.assign((placements.size() + 63) / 64, 0);
+
+        auto &footprints = scratch.footprints;
+        if (footprints.size() < blocks.size())
+            footprints.resize(blocks.size());
+        int padding = 0;
+
+        for (unsigned int i = 0; i < blocks.size(); i++)
         {
-            for (unsigned int x = 0; x < OTHER_W; x++)
+            auto &fp = footprints[i];
+            fp.rows.clear();
+            fp.min_x = OTHER_W, fp.max_x = -1, fp.min_z = OTHER_H, fp.max_z = -1;
+            fp.min_h = -1, fp.max_h = -1;
+
+            for (int h = 0; h < blocks[i].Layers(); h++)
             {
-                for (unsigned int z = 0; z < OTHER_H; z++)
+                for (int z = 0; z < OTHER_H; z++)
                 {
-                    if (other.Element(x, z, h))
-                    {
-                        if (x + offset_x < 0 || x + offset_x >= W)
-                            return true;
-                        if (z + offset_z < 0 || z + offset_z >= H)
-                            return true;
-
-                        if (h + offset_height >= heap_.size())
-                            continue;
-
-                        if (other.Element(x, z, h) &&
-                            Element(x + offset_x, z + offset_z, h + offset_height))
-                        {
-                            return true;
-                        }
-                    }
+                    uint32_t row = blocks[i].Row(z, h);
+                    if (!row)
+                        continue;
+
+                    fp.rows.push_back({h * H + z, row});
+                    fp.min_x = std::min(fp.min_x, __builtin_ctz(row));
+                    fp.max_x = std::max(fp.max_x, 31 - __builtin_clz(row));
+                    fp.min_z = std::min(fp.min_z, z);
+                    fp.max_z = std::max(fp.max_z, z);
+                    fp.min_h = fp.min_h < 0 ? h : fp.min_h;
+                    fp.max_h = h;
                 }
             }
+            padding = std::max(padding, fp.max_h + 1);
         }
 
-        return false;
+        // Rows above the top layer stay empty, so the kernel never has to check heights.
+        auto &rows = scratch.rows;
+        rows.assign((Layers() + padding) * H, 0);
+        for (int h = 0; h < Layers(); h++)
+            for (int z = 0; z < H; z++)
+                rows[h * H + z] = Row(z, h);
+
+        auto &buckets = scratch.buckets;
+        if (buckets.size() < blocks.size())
+            buckets.resize(blocks.size());
+        for (unsigned int o = 0; o < blocks.size(); o++)
+            buckets[o].clear();
+
+        for (unsigned int i = 0; i < placements.size(); i++)
+        {
+            const auto &p = placements[i];
+            ASSERT(p.orientation >= 0 && p.orientation < int(blocks.size()));
+            const auto &fp = footprints[p.orientation];
+
+            if (fp.rows.empty())
+                continue;
+
+            if (p.x + fp.min_x < 0 || p.x + fp.max_x >= width_ || p.z + fp.min_z < 0 ||
+                p.z + fp.max_z >= depth_ || p.height + fp.min_h < 0)
+                ret[i / 64] |= uint64_t(1) << (i % 64);
+            else if (p.height + fp.min_h < Layers())
+                buckets[p.orientation].push_back(i);
+        }
+
+        auto &base = scratch.base;
+        auto &shift = scratch.shift;
+        auto &hits = scratch.hits;
+
+        for (unsigned int o = 0; o < blocks.size(); o++)
+        {
+            const auto &bucket = buckets[o];
+            if (bucket.empty())
+                continue;
+
+            base.resize(bucket.size());
+            shift.resize(bucket.size());
+            hits.resize(bucket.size());
+
+            for (unsigned int i = 0; i < bucket.size(); i++)
+            {
+                const auto &p = placements[bucket[i]];
+                base[i] = p.height * H + p.z;
+                shift[i] = p.x;
+            }
+
+            CheckRowCollisions(rows.data(), footprints[o].rows.data(),
+                               int(footprints[o].rows.size()), base.data(), shift.data(),
+                               int(bucket.size()), hits.data());
+
+            for (unsigned int i = 0; i < bucket.size(); i++)
+                if (hits[i])
+                    ret[bucket[i] / 64] |= uint64_t(1) << (bucket[i] % 64);
+        }
     }
 
     enum RotationDirection
@@ -90,57 +376,250 @@ template <int W, int H> class Geometry
         Right
     };
 
-    Geometry<W, H> Rotate(RotationDirection dir)
+    Geometry<W, H> Rotate(RotationDirection dir) const
     {
         Geometry<W, H> ret;
-        ret.heap_.resize(heap_.size());
-        ASSERT(heap_.size() == W);
-        ASSERT(heap_.size() == H);
+        ASSERT(Layers() == W);
+        ASSERT(Layers() == H);
 
-        for (unsigned int h = 0; h < heap_.size(); h++)
-            for (unsigned int x = 0; x < W; x++)
-                for (unsigned int z = 0; z < H; z++)
+        for (int h = 0; h < Layers(); h++)
+            ret.AddEmptyLayer();
+
+        for (int h = 0; h < Layers(); h++)
+            for (int x = 0; x < W; x++)
+                for (int z = 0; z < H; z++)
                     switch (dir)
                     {
                     case Left:
-                        ret.Element(z, (W - 1 - x), h) = Element(x, z, h);
+                        ret.SetElement(z, (W - 1 - x), h, Element(x, z, h));
                         break;
                     case Right:
-                        ret.Element((W - z - 1), x, h) = Element(x, z, h);
+                        ret.SetElement((W - z - 1), x, h, Element(x, z, h));
                         break;
                     case Forward:
-                        ret.Element((W - 1 - h), z, x) = Element(x, z, h);
+                        ret.SetElement((W - 1 - h), z, x, Element(x, z, h));
                         break;
                     case Backward:
-                        ret.Element(h, z, (W - 1 - x)) = Element(x, z, h);
+                        ret.SetElement(h, z, (W - 1 - x), Element(x, z, h));
                         break;
                     }
 
         return ret;
     }
 
+    static uint32_t PackColor(uint32_t r, uint32_t g, uint32_t b)
+    {
+        return r + (g << 8) + (b << 16);
+    }
+
+    void Repaint(uint8_t color)
+    {
+        for (int h = 0; h < Layers(); h++)
+        {
+            for (auto &cell : slots_[order_[h]].cells)
+                if (cell)
+                    cell = color;
+            slots_[order_[h]].stamp = stamps_.Next();
+        }
+    }
+
     void Repaint(uint32_t r, uint32_t g, uint32_t b)
     {
-        for (unsigned int h = 0; h < heap_.size(); h++)
-            for (unsigned int x = 0; x < W; x++)
-                for (unsigned int z = 0; z < H; z++)
-                    if (Element(x, z, h))
-                        Element(x, z, h) = r + (g << 8) + (b << 16);
+        Repaint(Palette::inst().Intern(PackColor(r, g, b)));
     }
 
-    bool CheckFullLayer(int layer)
+    // Geometries are equal if the same cells are occupied, colors are not compared.
+    bool operator==(const Geometry<W, H> &other) const
     {
-        for (unsigned int x = 0; x < W; x++)
-            for (unsigned int z = 0; z < H; z++)
-                if (!Element(x, z, layer))
-                    return false;
+        if (Layers() != other.Layers())
+            return false;
+
+        for (int h = 0; h < Layers(); h++)
+            if (Occupancy(h) != other.Occupancy(h))
+                return false;
 
         return true;
     }
 
-    void RemoveLayer(int layer) { heap_.erase(heap_.begin() + layer); }
+    bool CheckFullLayer(int layer) const
+    {
+        return layer >= 0 && layer < Layers() && Occupancy(layer) == full_;
+    }
+
+    // Only the slot index is erased, the layers above are not moved.
+    void RemoveLayer(int layer)
+    {
+        free_.push_back(order_[layer]);
+        order_.erase(order_.begin() + layer);
+
+        for (int i = 0; i < W * H; i++)
+        {
+            if (tops_[i] > layer + 1)
+                tops_[i]--;
+            else if (tops_[i] == layer + 1)
+                tops_[i] = FindTop(i, layer);
+        }
+    }
+
+    // Removes every full layer in [from, to) in a single compaction pass, returns the
+    // number of removed layers.
+    int RemoveFullLayers(int from, int to)
+    {
+        from = std::max(from, 0);
+        to = std::min(to, Layers());
+
+        int write = from;
+        for (int read = from; read < Layers(); read++)
+        {
+            if (read < to && CheckFullLayer(read))
+                free_.push_back(order_[read]);
+            else
+                order_[write++] = order_[read];
+        }
+
+        int removed = Layers() - write;
+        order_.resize(write);
+
+        // Every column crosses the removed (full) layers, so every column drops by
+        // `removed`, unless its top was one of them.
+        if (removed)
+            for (int i = 0; i < W * H; i++)
+                tops_[i] = tops_[i] > to ? tops_[i] - removed : FindTop(i, tops_[i]);
+
+        return removed;
+    }
+
+    // Resting height of other dropped at (offset_x, offset_z) from from_height: the
+    // lowest offset_height <= from_height it can reach without colliding. Computed from
+    // the column heights and the bottom profile of other, only if other is stuck under
+    // an overhang the layers have to be walked.
+    template <int OTHER_W, int OTHER_H>
+    int DropHeight(const Geometry<OTHER_W, OTHER_H> &other, int offset_x, int offset_z,
+                   int from_height) const
+    {
+        std::array<uint32_t, OTHER_H> seen{};
+        int rest = from_height;
+        bool any = false;
+
+        for (int h = 0; h < other.Layers(); h++)
+        {
+            for (int z = 0; z < OTHER_H; z++)
+            {
+                uint32_t bottom = other.Row(z, h) & ~seen[z];
+                seen[z] |= bottom;
+
+                for (; bottom; bottom &= bottom - 1)
+                {
+                    int x = __builtin_ctz(bottom) + offset_x;
+                    if (x < 0 || x >= width_ || z + offset_z < 0 || z + offset_z >= depth_)
+                        return from_height;
+
+                    int column_rest = tops_[(z + offset_z) * W + x] - h;
+                    rest = any ? std::max(rest, column_rest) : column_rest;
+                    any = true;
+                }
+            }
+        }
+
+        if (rest <= from_height)
+            return rest;
+
+        int ret = from_height;
+        while (!CheckCollision(other, offset_x, offset_z, ret - 1))
+            ret--;
+        return ret;
+    }
 
     template <int OTHER_W, int OTHER_H>
     bool Collides(const Geometry<OTHER_W, OTHER_H> &other, int offset_x, int offset_z,
                   int offset_height);
-};
\ No newline at end of file
+
+  private:
+    struct Slot
+    {
+        // Colors of the cells, zero means empty. This is what gets rendered.
+        Layer cells;
+        // Kept in sync with cells, used for all the occupancy queries.
+        Plane occupancy;
+        uint64_t stamp;
+    };
+
+    // Layers live in slots which never move, order_ maps the layer index to its slot.
+    // Removed layers put their slot on the free list for the next AddXLayer.
+    std::vector<Slot> slots_;
+    std::vector<int> order_;
+    std::vector<int> free_;
+
+    int width_, depth_;
+    // occupancy of a full layer within the extent
+    Plane full_;
+
+    // per column ColumnHeight, kept up to date by every modification
+    std::array<int, W * H> tops_{};
+
+    LayerStamps stamps_;
+
+    // Top of the column i looking only at the layers below `below`.
+    int FindTop(int i, int below) const
+    {
+        for (int h = std::min(below, Layers()) - 1; h >= 0; h--)
+            if (Occupancy(h).Test(i))
+                return h + 1;
+        return 0;
+    }
+
+    const Plane &Occupancy(int h) const { return slots_[order_[h]].occupancy; }
+
+    int AllocateSlot()
+    {
+        int slot;
+        if (free_.empty())
+        {
+            slot = int(slots_.size());
+            slots_.emplace_back();
+        }
+        else
+        {
+            slot = free_.back();
+            free_.pop_back();
+        }
+
+        order_.push_back(slot);
+        slots_[slot].stamp = stamps_.Next();
+        return slot;
+    }
+
+    // Moves the row by `offset` cells, fails if any cell leaves [0, width).
+    static bool ShiftRow(uint64_t row, int offset, int width, uint64_t &shifted)
+    {
+        if (offset >= 64 || offset <= -64)
+            return false;
+
+        if (offset >= 0)
+        {
+            if (offset > 0 && (row >> (64 - offset)))
+                return false;
+            shifted = row << offset;
+        }
+        else
+        {
+            if (row & ((uint64_t(1) << -offset) - 1))
+                return false;
+            shifted = row >> -offset;
+        }
+
+        return (shifted >> width) == 0;
+    }
+
+    // Moves the row by `offset` cells, dropping the cells that leave [0, width).
+    static uint64_t ClipRow(uint64_t row, int offset, int width)
+    {
+        if (offset >= 64 || offset <= -64)
+            return 0;
+
+        row = offset >= 0 ? row << offset : row >> -offset;
+        return row & ((uint64_t(1) << width) - 1);
+    }
+
+    template <int, int> friend class Geometry;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <map>
+
+// Thin cache in front of the GL calls made while drawing: binds and uniform writes
+// that wouldn't change anything are skipped. Everything that goes through it is
+// counted, so the per-frame call counts can be compared between render paths.
+//
+// The cache assumes it is the only one binding vertex arrays and writing these
+// uniforms of the current program.
+class GlState
+{
+  public:
+    struct Counters
+    {
+        int calls = 0;
+        int skipped = 0;
+        int draws = 0;
+    };
+
+    void BindVertexArray(GLuint vao);
+
+    void Uniform(GLint location, int value);
+    void Uniform(GLint location, const glm::vec3 &value);
+    void Uniform(GLint location, const glm::mat4 &value);
+
+    void DrawElements(GLenum mode, GLsizei count);
+    void DrawElementsInstanced(GLenum mode, GLsizei count, GLsizei instances);
+    void DrawArrays(GLenum mode, GLsizei count);
+    // commands from the bound GL_DRAW_INDIRECT_BUFFER, tightly packed
+    void MultiDrawElementsIndirect(GLenum mode, const GLvoid *offset, GLsizei commands);
+    void MultiDrawArraysIndirect(GLenum mode, const GLvoid *offset, GLsizei commands);
+
+    // Starts counting a new frame.
+    void EndFrame();
+    const Counters &LastFrame() const { return last_frame_; }
+
+  private:
+    GLuint vao_ = 0;
+    std::map<GLint, int> ints_;
+    std::map<GLint, glm::vec3> vec3s_;
+    std::map<GLint, glm::mat4> mat4s_;
+
+    Counters frame_, last_frame_;
+
+    // Returns whether the call has to be made, updating the cached value.
+    template <typename T>
+    bool Changed(std::map<GLint, T> &cache, GLint location, const T &value);
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <deque>
+#include <vector>
+
+// GPU time of GL work, measured with GL_TIME_ELAPSED queries and recorded into the
+// Profiler. Results are only collected once the GPU has them, usually a few frames
+// later, so the timer never waits for the GPU. Scopes can't nest.
+//
+// Does nothing without ARB_timer_query.
+class GpuTimer
+{
+  public:
+    GpuTimer();
+    ~GpuTimer();
+
+    void Begin(const char *name);
+    void End();
+
+    // Records the finished queries, once per frame.
+    void EndFrame();
+
+  private:
+    struct Query
+    {
+        GLuint id;
+        const char *name;
+    };
+
+    const bool supported_;
+
+    // in the order they were issued, so results become available front to back
+    std::deque<Query> pending_;
+    std::vector<GLuint> free_;
+};
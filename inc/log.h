@@ -1,5 +1,8 @@
 #pragma once
 
+#include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 
@@ -12,8 +15,11 @@ class LoggingSingleton
 {
   private:
     LoggingSingleton();
+    // modules get registered from every thread that logs
+    std::mutex mutex_;
     std::vector<spdlog::sink_ptr> sinks_;
-    std::vector<std::shared_ptr<spdlog::logger>> handles_;
+    // one logger per module, shared by all its Log instances
+    std::map<std::string, std::shared_ptr<spdlog::logger>> handles_;
 
   public:
     LoggingSingleton(LoggingSingleton const &) = delete;
@@ -26,6 +32,7 @@ class LoggingSingleton
     }
 
     void SetConsoleVerbosity(bool verbose);
+    // Call before starting threads, the registered modules get the file too.
     void AddLogFile(std::string name);
 
     std::shared_ptr<spdlog::logger> RegisterModule(std::string name);
@@ -39,6 +46,7 @@ class LogStream
     std::stringstream stream_;
     spdlog::level::level_enum level_;
 
+    // filtered out levels don't format anything
     LogStream(std::shared_ptr<spdlog::logger>, spdlog::level::level_enum level);
     LogStream(const LogStream &);
 
@@ -56,7 +64,8 @@ class Log
 {
     std::string module_;
 
-    std::weak_ptr<spdlog::logger> handle_;
+    // registered on first use, accessed atomically as a Log may be shared by threads
+    mutable std::shared_ptr<spdlog::logger> handle_;
     std::shared_ptr<spdlog::logger> GetHandle() const;
 
   public:
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+// Colors shared by all the geometries. Cells only store an index into the palette,
+// index 0 means an empty cell. The colors of the falling blocks are laid out once at
+// startup, so picking one is an index computation without locking.
+class Palette
+{
+  private:
+    Palette();
+
+    // shades of every channel of the block colors, LEVELS^3 entries in total
+    static const int LEVELS = 6;
+    static const int FIRST_BLOCK_COLOR = 2;
+
+    std::array<uint32_t, 256> colors_;
+    std::atomic<int> size_;
+    std::mutex mutex_;
+
+  public:
+    Palette(Palette const &) = delete;
+    void operator=(Palette const &) = delete;
+
+    static Palette &inst()
+    {
+        static Palette instance;
+        return instance;
+    }
+
+    // Returns the index of the packed RGB color, adding it to the palette if needed.
+    // Once the palette is full the closest color already in it is used instead.
+    uint8_t Intern(uint32_t color);
+
+    // Number of block colors and the palette index of the n-th one.
+    int BlockColors() const { return LEVELS * LEVELS * LEVELS; }
+    uint8_t BlockColor(int n) const { return uint8_t(FIRST_BLOCK_COLOR + n); }
+
+    // Entries never change once added, so this needs no locking.
+    uint32_t Resolve(uint8_t index) const { return colors_[index]; }
+
+    int Size() const { return size_; }
+};
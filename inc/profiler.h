@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "log.h"
+
+// The last `capacity` samples of one measurement.
+class Histogram
+{
+  public:
+    explicit Histogram(size_t capacity = 1024);
+
+    void Add(float sample);
+    size_t Count() const { return samples_.size(); }
+    // p in [0, 1], nearest rank over the kept samples
+    float Percentile(float p) const;
+
+  private:
+    size_t capacity_;
+    size_t next_;
+    std::vector<float> samples_;
+};
+
+// Named timings in milliseconds, gathered from all threads into rolling histograms.
+class Profiler
+{
+  private:
+    Profiler() = default;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Histogram> histograms_;
+
+    Log log_{"Profiler"};
+
+  public:
+    Profiler(Profiler const &) = delete;
+    void operator=(Profiler const &) = delete;
+
+    static Profiler &inst()
+    {
+        static Profiler instance;
+        return instance;
+    }
+
+    // Times the CPU between its construction and destruction.
+    class Scope
+    {
+      public:
+        explicit Scope(const char *name)
+            : name_(name), start_(std::chrono::steady_clock::now())
+        {
+        }
+        ~Scope();
+
+      private:
+        const char *name_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    void Record(const std::string &name, float ms);
+
+    // Logs p50/p95/p99 and max of every timing.
+    void Report() const;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "action.h"
+#include "log.h"
+
+class Gameplay;
+
+// A game is fully determined by the Gameplay seed, the options and the simulation
+// step every action was applied in. Replay files hold exactly that:
+//
+//   "T3DR", u32 version, u32 seed, u32 option count,
+//   options as u16 length + "--name=value",
+//   9 byte records: u32 tick, u8 action, u32 action time (float bits),
+//   closed by a record with action END and the number of spawned blocks instead
+//   of the time.
+//
+// Numbers are stored little endian.
+class ReplayRecorder
+{
+  public:
+    ReplayRecorder(const std::string &path, uint32_t seed);
+
+    void Record(uint32_t tick, const TimedAction &action);
+    // `blocks` is checked against the replayed game
+    void Finish(uint32_t tick, int blocks);
+
+  private:
+    std::ofstream file_;
+    Log log_{"Replay"};
+};
+
+class Replay
+{
+  public:
+    // Returns false if the file couldn't be read.
+    bool Load(const std::string &path);
+
+    uint32_t Seed() const { return seed_; }
+
+    // Restores the recorded options, except the ones naming replay files.
+    void ApplyOptions() const;
+
+    // Hands the actions recorded for `tick` over to gameplay, ticks must not go back.
+    void Apply(Gameplay &gameplay, uint32_t tick);
+
+    // If the recording ended at `tick`, e.g. because the player quit.
+    bool Ended(uint32_t tick) const { return finished_ && tick >= end_tick_; }
+
+    // Logs whether the replayed game ended like the recorded one, returns false if not.
+    bool Check(uint32_t tick, int blocks) const;
+
+  private:
+    struct Entry
+    {
+        uint32_t tick;
+        TimedAction action;
+    };
+
+    uint32_t seed_ = 0;
+    std::vector<std::string> options_;
+    std::vector<Entry> entries_;
+    size_t next_ = 0;
+
+    bool finished_ = false;
+    uint32_t end_tick_ = 0;
+    int blocks_ = 0;
+
+    Log log_{"Replay"};
+};
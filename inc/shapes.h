@@ -0,0 +1,54 @@
+#pragma once
+
+#include "consts.h"
+#include "geometry.h"
+
+#include <array>
+#include <vector>
+
+typedef Geometry<BLOCK_SIZE, BLOCK_SIZE> BlockGeometry;
+
+// Every distinct orientation of every tetris shape, expanded once at startup.
+// Orientations are referred to by their index, rotating one is a table lookup.
+class ShapeTable
+{
+  private:
+    ShapeTable();
+
+    std::vector<BlockGeometry> orientations_;
+    // next orientation for every RotationDirection
+    std::vector<std::array<int, 4>> transitions_;
+    std::vector<int> shape_of_;
+    // [first, last) range of orientations of every shape, first is the spawn one
+    std::vector<std::pair<int, int>> shapes_;
+
+    Log log_{"ShapeTable"};
+
+  public:
+    ShapeTable(ShapeTable const &) = delete;
+    void operator=(ShapeTable const &) = delete;
+
+    static ShapeTable &inst()
+    {
+        static ShapeTable instance;
+        return instance;
+    }
+
+    int Shapes() const { return int(shapes_.size()); }
+    int SpawnOrientation(int shape) const { return shapes_[shape].first; }
+    std::pair<int, int> OrientationRange(int shape) const { return shapes_[shape]; }
+
+    int Shape(int orientation) const { return shape_of_[orientation]; }
+    const BlockGeometry &Orientation(int orientation) const
+    {
+        return orientations_[orientation];
+    }
+
+    // All orientations of all shapes, suitable for Geometry::CheckCollisions.
+    const std::vector<BlockGeometry> &Orientations() const { return orientations_; }
+
+    int Rotate(int orientation, BlockGeometry::RotationDirection dir) const
+    {
+        return transitions_[orientation][dir];
+    }
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "action.h"
+#include "autoplayer.h"
+#include "gameplay.h"
+#include "log.h"
+#include "replay.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Runs Gameplay on its own thread with a fixed time step, so the game speed doesn't
+// depend on the frame rate. Every batch of steps publishes a GameSnapshot, the render
+// thread draws interpolated between the last two it picked up.
+//
+// With a replay the actions come from it instead of PushAction. Otherwise the game is
+// recorded when the record_file option is set, and the autoplay option adds the
+// actions of an Autoplayer to the pushed ones.
+class Simulation
+{
+  public:
+    explicit Simulation(Replay *replay = nullptr);
+    ~Simulation();
+
+    // Seconds since the simulation started, the clock of action and snapshot times.
+    float Now() const;
+
+    // The action is applied in the step that covers its time. Input thread only,
+    // returns false if the queue is full and the action was dropped.
+    bool PushAction(TimedAction action);
+
+    // Picks up the latest published snapshot. Render thread only, as are the getters.
+    void Poll();
+    const GameSnapshot &Previous() const { return previous_; }
+    const GameSnapshot &Current() const { return current_; }
+
+    // Position of the frame drawn at `time` between Previous() and Current(). Frames
+    // are drawn one step in the past, so there is almost always a newer snapshot to
+    // interpolate towards.
+    float Alpha(float time) const;
+
+  private:
+    const float step_;
+    const std::chrono::steady_clock::time_point start_;
+
+    // owned by the simulation thread, as are the replay and the recorder
+    Replay *replay_;
+    const uint32_t seed_;
+    Gameplay gameplay_;
+    std::unique_ptr<ReplayRecorder> recorder_;
+    std::unique_ptr<Autoplayer> autoplayer_;
+    // block_serial of the last block the autoplayer moved
+    int autoplayed_block_;
+    std::vector<Action> autoplayed_actions_;
+
+    SpscQueue<TimedAction, 256> actions_;
+    // taken from actions_ but not due yet, simulation thread only
+    std::deque<TimedAction> waiting_actions_;
+
+    TripleBuffer<GameSnapshot> snapshots_;
+    GameSnapshot previous_;
+    GameSnapshot current_;
+
+    std::atomic<bool> stop_;
+    std::thread thread_;
+
+    Log log_{"Simulation"};
+
+    void Run();
+    // Hands the actions up to `time` over to gameplay_ in the step `tick`, measuring
+    // how long after the input each one got applied.
+    void ApplyActions(uint32_t tick, float time);
+};
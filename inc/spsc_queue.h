@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue between one producer thread and one consumer thread. Holds
+// up to N - 1 elements, Push fails when it is full.
+template <typename T, size_t N> class SpscQueue
+{
+  public:
+    // producer side
+    bool Push(const T &value)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) % N;
+        if (next == head_.load(std::memory_order_acquire))
+            return false;
+
+        buffer_[tail] = value;
+        tail_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    bool Pop(T &value)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+
+        value = buffer_[head];
+        head_.store((head + 1) % N, std::memory_order_release);
+        return true;
+    }
+
+  private:
+    std::array<T, N> buffer_;
+    // on separate cache lines, each side only writes its own
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads for splitting short jobs into parallel loops. The calling thread
+// takes part in every loop, so a pool of n threads only starts n - 1 workers, and a
+// pool of one runs everything inline.
+class ThreadPool
+{
+  public:
+    // 0 picks one thread per core
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    int Threads() const { return int(workers_.size()) + 1; }
+
+    // Calls f(i, thread) for every i in [0, count) and returns once all of them are
+    // done. `thread` is in [0, Threads()) and unique among the concurrent calls, for
+    // indexing per thread scratch data.
+    //
+    // Every thread starts with an equal share of the indices and works through it in
+    // order. One that runs out steals the upper half of what another has left, so
+    // uneven work still spreads evenly.
+    void ParallelFor(int count, const std::function<void(int, int)> &f);
+
+  private:
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    // bumped for every loop, workers wait for a new one
+    uint64_t generation_;
+    bool stop_;
+    // workers still in the current loop
+    int active_;
+
+    const std::function<void(int, int)> *job_;
+    // indices a thread takes from its own share at once
+    int chunk_;
+
+    // [begin, end) left of the share of a thread, packed into one word so the owner
+    // taking from the front and thieves cutting off the back can't race
+    struct Share
+    {
+        std::atomic<uint64_t> range;
+        // one cache line each
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+    std::unique_ptr<Share[]> shares_;
+
+    void RunWorker(int thread);
+    void Work(int thread);
+    bool TakeOwn(int thread, int &begin, int &end);
+    bool Steal(int thread);
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+// Lock-free hand-over of the latest value from one writer thread to one reader thread.
+// The writer fills Back() and publishes it, the reader picks up the newest published
+// value with Consume(). Neither side ever waits for the other, values published
+// between two Consume() calls are dropped.
+template <typename T> class TripleBuffer
+{
+  public:
+    // writer side
+    T &Back() { return buffers_[back_]; }
+    void Publish()
+    {
+        back_ = middle_.exchange(back_ | DIRTY, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // reader side, returns if Front() changed since the last call
+    bool Consume()
+    {
+        if (!(middle_.load(std::memory_order_acquire) & DIRTY))
+            return false;
+
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    const T &Front() const { return buffers_[front_]; }
+
+  private:
+    static constexpr int INDEX = 3;
+    static constexpr int DIRTY = 4;
+
+    std::array<T, 3> buffers_;
+    int back_ = 0;
+    int front_ = 1;
+    // index of the buffer between the two sides, DIRTY when it wasn't consumed yet
+    std::atomic<int> middle_{2};
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "log.h"
+
+// Writes RGBA frames to an uncompressed video file. Files ending in .y4m get a
+// YUV4MPEG2 stream (4:4:4, BT.601 studio range) most players and encoders read
+// directly, anything else gets raw RGB24 frames.
+class VideoWriter
+{
+  public:
+    VideoWriter(const std::string &path, int width, int height, int fps);
+
+    // `rgba` holds width * height pixels, rows bottom-up as GL reads them.
+    void Write(const uint8_t *rgba);
+
+    bool Good() const { return file_.good(); }
+
+  private:
+    const int width_;
+    const int height_;
+    const bool y4m_;
+
+    std::ofstream file_;
+    // one converted frame, reused
+    std::vector<uint8_t> planes_;
+
+    Log log_{"VideoWriter"};
+};
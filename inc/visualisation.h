@@ -4,81 +4,168 @@
 
 #include <SDL2pp/SDL2pp.hh>
 #include <boost/optional/optional.hpp>
+#include <condition_variable>
 #include <functional>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <random>
+#include <thread>
 
+#include "action.h"
+#include "board.h"
+#include "buffer_pool.h"
+#include "frame_capture.h"
+#include "gl_state.h"
 #include "geometry.h"
+#include "gpu_timer.h"
 #include "log.h"
 #include "shader.h"
 #include "trajectory.h"
 
+// Block meshes only have walls on the half-integer grid, facing one of the six axes,
+// so the vertices are stored packed and unpacked in vertex.shader.
 struct Vertex
 {
-    glm::vec3 pos_;
-    glm::vec2 tex_;
-    glm::vec3 norm_;
-    glm::vec3 diffuse_;
+    // position in half units
+    int16_t pos_[3];
+    // wall size in cells at the far corner, see BuildSegment
+    uint8_t tex_[2];
+    uint8_t diffuse_[3];
+    // index of the normal axis: -x, +x, -y, +y, -z, +z (6 for none)
+    uint8_t norm_;
 
     Vertex(glm::vec3 pos, glm::vec2 tex, glm::vec3 norm, glm::vec3 diffuse)
-        : pos_(pos), tex_(tex), norm_(norm), diffuse_(diffuse){};
+        : pos_{int16_t(glm::round(pos.x * 2.0f)), int16_t(glm::round(pos.y * 2.0f)),
+               int16_t(glm::round(pos.z * 2.0f))},
+          tex_{uint8_t(tex.x), uint8_t(tex.y)},
+          diffuse_{uint8_t(glm::round(diffuse.x * 255.0f)),
+                   uint8_t(glm::round(diffuse.y * 255.0f)),
+                   uint8_t(glm::round(diffuse.z * 255.0f))},
+          norm_(norm.x != 0 ? (norm.x > 0) : norm.y != 0 ? 2 + (norm.y > 0)
+                                            : norm.z != 0 ? 4 + (norm.z > 0) : 6){};
+
+    void Lift(int layers) { pos_[1] += layers * 2; }
+};
+
+static_assert(sizeof(Vertex) == 12, "Vertex is expected to be tightly packed");
+
+// One occupied cell in the instanced mode, drawn as the unit cube of Visualisation.
+struct Instance
+{
+    // x, h, z
+    uint8_t pos_[3];
+    // bit n is set if the wall with normal index n (see Vertex) is covered
+    uint8_t hidden_;
+    uint8_t diffuse_[4];
+
+    Instance(int x, int z, uint8_t hidden, glm::vec3 diffuse)
+        : pos_{uint8_t(x), 0, uint8_t(z)}, hidden_(hidden),
+          diffuse_{uint8_t(glm::round(diffuse.x * 255.0f)),
+                   uint8_t(glm::round(diffuse.y * 255.0f)),
+                   uint8_t(glm::round(diffuse.z * 255.0f)), 0xff} {};
+
+    void Lift(int layers) { pos_[1] += layers; }
 };
 
+static_assert(sizeof(Instance) == 8, "Instance is expected to be tightly packed");
+
 class Visualisation
 {
   public:
-    enum Action
-    {
-        Exit,
-        // fixme: North, West, etc. names are stupid in this case
-        MoveNorth,
-        MoveSouth,
-        MoveWest,
-        MoveEast,
-        RotateForward,
-        RotateBackward,
-        RotatetLeft,
-        RotatetRight,
-        StartBoost,
-        StopBoost
-    };
-
     class Object
     {
       public:
+        // Meshes are built on the mesh worker and uploaded by Render on a later
+        // frame, until then the previous mesh is drawn.
         template <int W, int H>
-        void LoadGeometry(Geometry<W, H> &geometry, bool create_markers = false);
+        void LoadGeometry(const Geometry<W, H> &geometry, bool create_markers = false);
+        void LoadGeometry(const Board &board, bool create_markers = false);
 
         void SetVisibility(bool visible);
+        // Tint multiplied with the vertex colors, markers stay white.
         void SetColor(glm::vec3 color);
         void SetPostion(glm::vec3 position);
-        void Rotate(float angle, glm::vec3 axis, float running_time);
-        void ResetRotation();
-        glm::quat GetOrientation(float running_time);
-        void Render(GLuint mode_id);
+        // Second, dimmed copy of the object without markers, e.g. the landing preview.
+        void SetGhost(bool visible, glm::vec3 position = glm::vec3());
+        void SetOrientation(glm::quat orientation);
+        void Render(bool ghost = false);
 
       private:
         Object(Visualisation &vis);
         ~Object();
         Visualisation &vis_;
 
-        GLuint vertex_buffer_;
-        GLuint index_buffer_;
+        // Mesh of a single geometry layer, in layer-local coordinates (y = 0). A
+        // segment only depends on its layer and the two neighbouring ones, so it is
+        // identified by their stamps and reused until one of them changes.
+        struct Segment
+        {
+            std::array<uint64_t, 4> key;
+            std::vector<Vertex> vertices;
+            std::vector<Vertex> markers;
+            std::vector<Instance> instances;
+        };
+
+        // Owned by the mesh worker.
+        std::vector<Segment> segments_;
+
+        // Changed tail of the mesh, everything before the first_* elements is the
+        // same as in the previous update.
+        struct MeshUpdate
+        {
+            std::vector<Vertex> vertices;
+            std::vector<Vertex> markers;
+            std::vector<Instance> instances;
+            size_t first_vertex, first_marker, first_instance;
+
+            // Folds a later update into this one when the render thread hasn't
+            // uploaded it yet.
+            void Append(MeshUpdate &&newer);
+        };
+
+        std::mutex pending_mutex_;
+        boost::optional<MeshUpdate> pending_;
+
+        // Meshes the layer h, merging neighbouring walls of the same color into
+        // larger quads with greedy meshing. In the instanced mode the segment gets one
+        // instance per cell instead of walls.
+        template <int W, int H>
+        void BuildSegment(const Geometry<W, H> &geometry, int h, Segment &segment) const;
+
+        template <int W, int H>
+        MeshUpdate BuildMesh(const Geometry<W, H> &geometry, bool create_markers);
+
+        // Uploads the latest update from the worker, if any. Render thread only.
+        void ApplyPendingMesh();
+
+        // Points the vertex arrays at the current ranges, after every upload.
+        void BuildVertexArrays();
+
+        GLuint mesh_vao_;
+        GLuint markers_vao_;
+        GLuint instances_vao_;
+
+        // ranges of Visualisation::buffer_pool_
+        BufferPool::Range vertex_range_;
+        BufferPool::Range markers_range_;
+        BufferPool::Range instance_range_;
         GLuint indices_count_;
-        GLuint markers_buffer_;
         GLuint markers_count_;
+        GLuint instance_count_;
 
         glm::vec3 color_;
         bool visible_;
         glm::vec3 pos_;
 
-        glm::quat target_rot_;
-        glm::quat initial_rot_;
-        glm::quat current_rot_;
-        Trajectory trajectory_rot_;
+        bool ghost_visible_;
+        glm::vec3 ghost_pos_;
+
+        glm::quat orientation_;
 
         bool inited_;
 
@@ -90,10 +177,24 @@ class Visualisation
     SDL2pp::Window window_;
     SDL_GLContext main_context_;
     const uint32_t rx_, ry_;
+    const int board_size_;
+    const bool greedy_meshing_;
+    const bool instanced_rendering_;
 
     // gl uniforms ids
-    GLuint vp_id_, m_id_, mode_id_;
+    GLuint vp_id_, m_id_, mode_id_, tint_id_, instanced_id_, batched_id_;
 
+    GlState gl_;
+    uint64_t frames_;
+    // if swaps wait for the display, see SetPresentMode
+    bool vsync_;
+    // created once GLEW is up
+    std::unique_ptr<GpuTimer> gpu_timer_;
+    // only when capture_file is set
+    std::unique_ptr<FrameCapture> capture_;
+
+    // Camera keys come from the input thread, the camera state is read while drawing.
+    std::mutex camera_mutex_;
     glm::vec3 camera_pos_;
     float fov_;
     float camera_dist_, camera_h_, camera_angle_, target_angle_;
@@ -105,13 +206,88 @@ class Visualisation
     // we need to keep track of
     int camera_action_shift_;
 
-    std::queue<Action> action_queue_;
+    // input thread only
+    std::queue<TimedAction> action_queue_;
     std::vector<Object *> objects_;
 
-    void HandleKeyDown(SDL_KeyboardEvent key, float running_time);
-    void HandleKeyUp(SDL_KeyboardEvent key, float running_time);
-    void HandleMouseKeyDown(SDL_MouseButtonEvent btn, float running_time);
+    // Vertex storage of all objects, created once GLEW is up.
+    std::unique_ptr<BufferPool> buffer_pool_;
+
+    // unit cube drawn for every Instance, see instanced_rendering_
+    BufferPool::Range cube_range_;
+
+    // Index buffer shared by all objects. Every quad is drawn with the same
+    // 0,1,2,0,1,3 pattern, so it only needs to be long enough for the largest mesh.
+    GLuint quad_indices_;
+    size_t quad_indices_capacity_;
+
+    void ReserveQuadIndices(size_t quads);
+
+    // Single background thread building object meshes. Jobs run in order, so the
+    // meshes of a single object are never built concurrently.
+    std::thread mesh_worker_;
+    std::mutex mesh_jobs_mutex_;
+    std::condition_variable mesh_jobs_cv_;
+    std::queue<std::function<void()>> mesh_jobs_;
+    bool mesh_worker_stop_;
+
+    void PostMeshJob(std::function<void()> job);
+    void RunMeshWorker();
+
+    // Whole scene in a multi-draw indirect call per buffer page and primitive, when
+    // the context supports it and batched_rendering is set.
+    bool batched_rendering_;
+
+    struct DrawData
+    {
+        glm::mat4 model;
+        // tint, w is the mode (see vertex.shader)
+        glm::vec4 tint;
+    };
+
+    // Layouts of the indirect commands, as defined by GL.
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLint base_vertex;
+        GLuint base_instance;
+    };
+
+    struct DrawArraysIndirectCommand
+    {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first;
+        GLuint base_instance;
+    };
+
+    GLuint draw_data_buffer_;
+    GLuint indirect_buffer_;
+    // buffer page -> vertex array reading the whole page and draw_data_buffer_
+    std::map<GLuint, GLuint> batch_vaos_;
+
+    // Filled by RenderBatched every frame, kept to reuse their storage. Buffer pages
+    // stay in the command maps with empty lists when nothing is drawn from them.
+    std::vector<DrawData> draw_data_;
+    std::map<GLuint, std::vector<DrawElementsIndirectCommand>> mesh_commands_;
+    std::map<GLuint, std::vector<DrawArraysIndirectCommand>> marker_commands_;
+    std::vector<char> indirect_commands_;
+    std::vector<std::pair<GLuint, const GLvoid *>> mesh_batches_, marker_batches_;
+
+    GLuint BatchVertexArray(GLuint buffer);
+    glm::mat4 ModelMatrix(glm::vec3 pos, glm::quat orientation) const;
+    void RenderObjects();
+    void RenderBatched();
+
+    // `time` is the time of the event
+    void HandleKeyDown(SDL_KeyboardEvent key, float time);
+    void HandleKeyUp(SDL_KeyboardEvent key, float time);
+    void HandleMouseKeyDown(SDL_MouseButtonEvent btn, float time);
     glm::mat4 UpdateCamera(float running_time);
+    // "vsync", "adaptive" or "immediate"
+    void SetPresentMode(const std::string &mode);
 
   public:
     Visualisation();
@@ -124,7 +300,23 @@ class Visualisation
 
     bool Render(float running_time);
 
+    // Whether swaps wait for the display, otherwise nothing limits the frame rate.
+    bool Vsync() const { return vsync_; }
+
+    // Window events are only delivered to the thread that created the window, so
+    // that thread handles input while another one renders. The GL context can only be
+    // current on one of them at a time.
+    void MakeCurrent();
+    void ReleaseCurrent();
+
+    // Waits up to `timeout_ms` for window events and turns them into actions, stamped
+    // with the time they happened, relative to `now`. Input thread only.
+    void PollInput(float now, int timeout_ms);
+
+    // GL calls made while drawing the last frame, see GlState.
+    const GlState::Counters &FrameGlCalls() const { return gl_.LastFrame(); }
+
     Log log_{"Visualisation"};
 
-    boost::optional<Visualisation::Action> DequeueAction();
+    boost::optional<TimedAction> DequeueAction();
 };
\ No newline at end of file
@@ -5,12 +5,31 @@
 
 precision mediump float;
 
+// see struct Vertex in visualisation.h
+// position in half units
 layout(location = 0) in vec3 pos;
+// wall size in cells at the far corner
 layout(location = 1) in vec2 uv;
+// normalized 8-bit color
 layout(location = 2) in vec3 diffuse;
-layout(location = 3) in vec3 normal;
+// normal axis index: -x, +x, -y, +y, -z, +z
+layout(location = 3) in float normal;
+// see struct Instance, only used when instanced == 1
+// x, h, z, mask of the covered walls
+layout(location = 4) in vec4 instance;
+layout(location = 5) in vec4 instance_diffuse;
+// per-draw M, tint and mode (in w), only used when batched == 1
+layout(location = 6) in mat4 draw_model;
+layout(location = 10) in vec4 draw_tint;
 
-uniform bool mode;
+// 0 - mesh, 1 - markers, 2 - ghost
+uniform int mode;
+// object color, multiplied with the vertex colors of the mesh
+uniform vec3 tint;
+// 1 when drawing the unit cube once per Instance
+uniform int instanced;
+// 1 when the per-draw values come from the draw_* attributes instead of uniforms
+uniform int batched;
 uniform mat4 VP;
 uniform mat4 M;
 
@@ -18,17 +37,37 @@ out vec2 uv_out;
 out vec3 diffuse_out;
 
 void main(){
-	vec4 abs_pos = M * vec4(pos, 1.0);
+	mat4 model = batched == 1 ? draw_model : M;
+	vec3 object_tint = batched == 1 ? draw_tint.rgb : tint;
+	int object_mode = batched == 1 ? int(draw_tint.w) : mode;
+
+	vec3 local = pos * 0.5;
+	vec3 color = diffuse;
+
+	if (instanced == 1)
+	{
+		// collapsing a covered wall into a point leaves nothing to rasterize
+		if (((int(instance.w) >> int(normal)) & 1) != 0)
+			local = vec3(0.0);
+
+		local += instance.xyz;
+		color *= instance_diffuse.rgb;
+	}
+
+	vec4 abs_pos = model * vec4(local, 1.0);
 
 	// if uv == (1,1) and we are in the marker mode we want
 	// to make the line go directly down by forcing 0 on the
 	// second vertex' y.
 	// fixme: too hacky.
-	if(mode && uv.x == 1.0 && uv.y == 1.0)
+	if(object_mode == 1 && uv.x == 1.0 && uv.y == 1.0)
 		abs_pos.y = 0.0;
 
 	gl_Position = VP * abs_pos;
 
-	diffuse_out = diffuse;
+	if (object_mode == 1)
+		diffuse_out = color;
+	else
+		diffuse_out = object_mode == 2 ? color * object_tint * 0.35 : color * object_tint;
 	uv_out = uv;
 }
\ No newline at end of file
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <functional>
+
+#include "autoplayer.h"
+#include "shapes.h"
+
+// Offsets of a block that still overlap the board, per axis: [-(BLOCK_SIZE - 1), size).
+static int Span(int size) { return size + BLOCK_SIZE - 1; }
+
+// fixme: hardcoded stuff, tuned with tetris_headless on a 10x10 board
+static const float HEIGHT_WEIGHT = 1.0f;
+static const float VARIANCE_WEIGHT = 0.4f;
+static const float HOLE_WEIGHT = 0.25f;
+static const float LANDING_WEIGHT = 0.1f;
+static const float LAYER_WEIGHT = 0.5f;
+
+Autoplayer::Autoplayer(int threads) : pool_(threads)
+{
+    const auto &table = ShapeTable::inst();
+    for (const auto &block : table.Orientations())
+    {
+        Profile profile;
+        profile.layer_cells.fill(0);
+
+        for (int z = 0; z < BLOCK_SIZE; z++)
+        {
+            for (int x = 0; x < BLOCK_SIZE; x++)
+            {
+                BlockColumn column{x, z, 0, 0};
+                for (int h = 0; h < block.Layers(); h++)
+                {
+                    if (!((block.Row(z, h) >> x) & 1))
+                        continue;
+
+                    column.top = h + 1;
+                    column.cells++;
+                    profile.layer_cells[h]++;
+                }
+
+                if (column.cells)
+                    profile.columns.push_back(column);
+            }
+        }
+
+        profiles_.push_back(profile);
+    }
+
+    log_.Info() << "Autoplay on " << pool_.Threads() << " threads";
+}
+
+void Autoplayer::Plan(const GameSnapshot &state, std::vector<Action> &actions)
+{
+    actions.clear();
+
+    const auto &table = ShapeTable::inst();
+    const Board &heap = *state.heap;
+    const int span = Span(heap.Size());
+    const int cells = span * span;
+    const int height = int(state.block_position.y);
+    const auto range = table.OrientationRange(table.Shape(state.block_orientation_index));
+    const int orientations = range.second - range.first;
+
+    auto cell = [&](int x, int z) {
+        return (z + BLOCK_SIZE - 1) * span + x + BLOCK_SIZE - 1;
+    };
+
+    // Everything is tested at the current height in one batch: the block is moved
+    // there before it falls any further.
+    placements_.clear();
+    for (int o = range.first; o < range.second; o++)
+        for (int z = 1 - BLOCK_SIZE; z < heap.Size(); z++)
+            for (int x = 1 - BLOCK_SIZE; x < heap.Size(); x++)
+                placements_.push_back({x, z, height, o});
+    heap.CheckCollisions(table.Orientations(), placements_, collisions_, collision_scratch_);
+    auto is_free = [&](int o, int c) {
+        int i = (o - range.first) * cells + c;
+        return !((collisions_[i / 64] >> (i % 64)) & 1);
+    };
+
+    const int start = cell(state.block_x, state.block_z);
+    if (!is_free(state.block_orientation_index, start))
+        return;
+
+    // Rotations happen in place, like Gameplay::TryRotate does them.
+    static const Action rotate_actions[] = {Action::RotateForward, Action::RotateBackward,
+                                            Action::RotatetLeft, Action::RotatetRight};
+    rotations_.assign(orientations, {Action::Exit, -1});
+    reached_.assign(orientations, false);
+    reached_[state.block_orientation_index - range.first] = true;
+    queue_.assign(1, state.block_orientation_index);
+    for (size_t i = 0; i < queue_.size(); i++)
+    {
+        for (int dir = 0; dir < 4; dir++)
+        {
+            int next = table.Rotate(queue_[i], BlockGeometry::RotationDirection(dir));
+            if (reached_[next - range.first] || !is_free(next, start))
+                continue;
+
+            reached_[next - range.first] = true;
+            rotations_[next - range.first] = {rotate_actions[dir], queue_[i]};
+            queue_.push_back(next);
+        }
+    }
+
+    // Then every rotated block spreads over the free cells at this height.
+    static const Action move_actions[] = {Action::MoveEast, Action::MoveWest,
+                                          Action::MoveNorth, Action::MoveSouth};
+    static const int move_x[] = {1, -1, 0, 0};
+    static const int move_z[] = {0, 0, 1, -1};
+    moves_.assign(orientations * cells, {Action::Exit, -1});
+    candidates_.clear();
+    for (int o : queue_)
+    {
+        auto *moves = &moves_[(o - range.first) * cells];
+        size_t first = candidates_.size();
+        candidates_.push_back({o, state.block_x, state.block_z});
+        moves[start].from = start;
+
+        for (size_t i = first; i < candidates_.size(); i++)
+        {
+            auto from = candidates_[i];
+            for (int dir = 0; dir < 4; dir++)
+            {
+                int x = from.x + move_x[dir], z = from.z + move_z[dir];
+                if (x <= -BLOCK_SIZE || x >= heap.Size() || z <= -BLOCK_SIZE ||
+                    z >= heap.Size())
+                    continue;
+
+                int c = cell(x, z);
+                if (moves[c].from >= 0 || !is_free(o, c))
+                    continue;
+
+                moves[c] = {move_actions[dir], cell(from.x, from.z)};
+                candidates_.push_back({o, x, z});
+            }
+        }
+    }
+
+    Measure(heap, surface_);
+
+    if (int(scratch_.size()) != pool_.Threads())
+    {
+        scratch_.assign(pool_.Threads(), heap);
+        scratch_surfaces_.resize(pool_.Threads());
+    }
+    scores_.resize(candidates_.size());
+
+    auto score = [&](int i, int thread) {
+        const auto &candidate = candidates_[i];
+        const auto &block = table.Orientation(candidate.orientation);
+        const auto &profile = profiles_[candidate.orientation];
+
+        int landing = heap.DropHeight(block, candidate.x, candidate.z, height);
+        if (ScoreDrop(profile, candidate.x, candidate.z, landing, scores_[i]))
+            return;
+
+        // Layers get cleared, play it out on a copy. Same landing as Gameplay::Update,
+        // which never removes the three floor layers.
+        auto &board = scratch_[thread];
+        board = heap;
+        board.Merge(block, candidate.x, candidate.z, landing, 1);
+        int removed = board.RemoveFullLayers(std::max(3, landing), landing + BLOCK_SIZE);
+
+        Measure(board, scratch_surfaces_[thread]);
+        scores_[i] = Score(scratch_surfaces_[thread], removed, landing);
+    };
+    // by reference, so std::function doesn't allocate for the captures
+    pool_.ParallelFor(int(candidates_.size()), std::ref(score));
+
+    // ties go to the first candidate, so the choice doesn't depend on the threads
+    auto best = candidates_[std::min_element(scores_.begin(), scores_.end()) -
+                            scores_.begin()];
+
+    actions.push_back(Action::HardDrop);
+    auto *moves = &moves_[(best.orientation - range.first) * cells];
+    for (int c = cell(best.x, best.z); c != start; c = moves[c].from)
+        actions.push_back(moves[c].action);
+    for (int o = best.orientation; o != state.block_orientation_index;
+         o = rotations_[o - range.first].from)
+        actions.push_back(rotations_[o - range.first].action);
+    std::reverse(actions.begin(), actions.end());
+}
+
+void Autoplayer::Measure(const Board &heap, Surface &surface)
+{
+    heap.Visit([&](const auto &geometry) {
+        surface.width = geometry.Width();
+        surface.columns = geometry.Width() * geometry.Depth();
+        surface.tops.resize(geometry.Width() * geometry.Depth());
+        surface.layer_cells.assign(geometry.Layers(), 0);
+        surface.sum = surface.sum_squares = surface.occupied = 0;
+
+        for (int z = 0; z < geometry.Depth(); z++)
+        {
+            for (int x = 0; x < geometry.Width(); x++)
+            {
+                int top = geometry.ColumnHeight(x, z);
+                surface.tops[z * geometry.Width() + x] = top;
+                surface.sum += top;
+                surface.sum_squares += top * top;
+            }
+
+            for (int h = 0; h < geometry.Layers(); h++)
+                surface.layer_cells[h] += __builtin_popcount(geometry.Row(z, h));
+        }
+
+        for (int cells : surface.layer_cells)
+            surface.occupied += cells;
+    });
+}
+
+float Autoplayer::Score(const Surface &surface, int removed, int landing)
+{
+    // Every cell under a column top that isn't occupied is a hole.
+    float mean = float(surface.sum) / surface.columns;
+    float variance = float(surface.sum_squares) / surface.columns - mean * mean;
+    int holes = surface.sum - surface.occupied;
+
+    return HEIGHT_WEIGHT * mean + VARIANCE_WEIGHT * variance + HOLE_WEIGHT * holes +
+           LANDING_WEIGHT * landing - LAYER_WEIGHT * removed;
+}
+
+bool Autoplayer::ScoreDrop(const Profile &profile, int offset_x, int offset_z,
+                           int landing, float &score) const
+{
+    for (int h = 0; h < BLOCK_SIZE; h++)
+    {
+        int layer = landing + h;
+        int cells = profile.layer_cells[h];
+        if (cells && layer < int(surface_.layer_cells.size()))
+            cells += surface_.layer_cells[layer];
+        if (cells == surface_.columns)
+            return false;
+    }
+
+    // A column the block rests on top of grows to the top of the block, the gaps below
+    // and inside the block turn into holes. Under an overhang the block only fills
+    // holes and the column keeps its height.
+    Surface after;
+    after.columns = surface_.columns;
+    after.sum = surface_.sum;
+    after.sum_squares = surface_.sum_squares;
+    after.occupied = surface_.occupied;
+
+    for (const auto &column : profile.columns)
+    {
+        int old_top =
+            surface_.tops[(column.z + offset_z) * surface_.width + column.x + offset_x];
+        int new_top = std::max(old_top, landing + column.top);
+        after.sum += new_top - old_top;
+        after.sum_squares += new_top * new_top - old_top * old_top;
+        after.occupied += column.cells;
+    }
+
+    score = Score(after, 0, landing);
+    return true;
+}
@@ -0,0 +1,98 @@
+#include "board.h"
+
+Board::Board(int size) : size_(size)
+{
+    ASSERT(size >= 1 && size <= MAX_SIZE,
+           "Unsupported board size: " + std::to_string(size));
+
+    if (size <= 6)
+        geometry_ = Geometry<6, 6>();
+    else if (size <= 8)
+        geometry_ = Geometry<8, 8>();
+    else if (size <= 10)
+        geometry_ = Geometry<10, 10>();
+    else if (size <= 12)
+        geometry_ = Geometry<12, 12>();
+    else if (size <= 16)
+        geometry_ = Geometry<16, 16>();
+    else
+        geometry_ = Geometry<32, 32>();
+
+    Visit([&](auto &geometry) { geometry.SetExtent(size, size); });
+}
+
+int Board::Layers() const
+{
+    return Visit([&](const auto &geometry) { return geometry.Layers(); });
+}
+
+void Board::Reserve(int layers)
+{
+    Visit([&](auto &geometry) { geometry.Reserve(layers); });
+}
+
+void Board::AddFullLayer()
+{
+    Visit([&](auto &geometry) { geometry.AddFullLayer(); });
+}
+
+void Board::Repaint(uint32_t r, uint32_t g, uint32_t b)
+{
+    Visit([&](auto &geometry) { geometry.Repaint(r, g, b); });
+}
+
+bool Board::CheckCollision(const BlockGeometry &block, int offset_x, int offset_z,
+                           int offset_height) const
+{
+    return Visit([&](const auto &geometry) {
+        return geometry.CheckCollision(block, offset_x, offset_z, offset_height);
+    });
+}
+
+std::vector<uint64_t> Board::CheckCollisions(const std::vector<BlockGeometry> &blocks,
+                                             const std::vector<Placement> &placements) const
+{
+    return Visit([&](const auto &geometry) {
+        return geometry.CheckCollisions(blocks, placements);
+    });
+}
+
+void Board::CheckCollisions(const std::vector<BlockGeometry> &blocks,
+                            const std::vector<Placement> &placements,
+                            std::vector<uint64_t> &ret, CollisionScratch &scratch) const
+{
+    Visit([&](const auto &geometry) {
+        geometry.CheckCollisions(blocks, placements, ret, scratch);
+    });
+}
+
+void Board::Merge(const BlockGeometry &block, int offset_x, int offset_z, int offset_height,
+                  uint8_t color)
+{
+    Visit([&](auto &geometry) {
+        geometry.Merge(block, offset_x, offset_z, offset_height, color);
+    });
+}
+
+bool Board::CheckFullLayer(int layer) const
+{
+    return Visit([&](const auto &geometry) { return geometry.CheckFullLayer(layer); });
+}
+
+int Board::RemoveFullLayers(int from, int to)
+{
+    return Visit([&](auto &geometry) { return geometry.RemoveFullLayers(from, to); });
+}
+
+int Board::ColumnHeight(int x, int z) const
+{
+    return Visit([&](const auto &geometry) { return geometry.ColumnHeight(x, z); });
+}
+
+int Board::DropHeight(const BlockGeometry &block, int offset_x, int offset_z,
+                      int from_height) const
+{
+    return Visit([&](const auto &geometry) {
+        return geometry.DropHeight(block, offset_x, offset_z, from_height);
+    });
+}
@@ -0,0 +1,183 @@
+#include "buffer_pool.h"
+#include "exceptions.h"
+
+#include <algorithm>
+#include <cstring>
+
+// vertex attributes and copies are happiest with aligned offsets
+static const size_t ALIGNMENT = 256;
+
+static size_t Align(size_t size, size_t alignment = ALIGNMENT)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+BufferPool::BufferPool(size_t page_size)
+    : page_size_(Align(page_size)), persistent_(GLEW_ARB_buffer_storage), frame_(0)
+{
+    log_.Info() << "Buffer pages are "
+                << (persistent_ ? "persistently mapped" : "not mapped");
+}
+
+BufferPool::~BufferPool()
+{
+    for (auto &fence : fences_)
+        glDeleteSync(fence.sync);
+
+    // deleting a buffer unmaps it as well
+    for (auto &page : pages_)
+        glDeleteBuffers(1, &page.buffer);
+}
+
+BufferPool::Range BufferPool::Allocate(size_t size, size_t element)
+{
+    Range ret;
+    if (size == 0)
+        return ret;
+
+    size = Align(size);
+
+    // smallest multiple of both, free ranges always start at a multiple of ALIGNMENT
+    size_t alignment = ALIGNMENT;
+    while (alignment % element)
+        alignment += ALIGNMENT;
+
+    auto take = [&](int index) {
+        auto &page = pages_[index];
+        for (auto it = page.free.begin(); it != page.free.end(); ++it)
+        {
+            size_t offset = Align(it->first, alignment);
+            size_t skipped = offset - it->first;
+            if (it->second < skipped + size)
+                continue;
+
+            ret.buffer = page.buffer;
+            ret.offset = offset;
+            ret.size = size;
+            ret.page = index;
+
+            size_t free_offset = it->first, free_size = it->second;
+            page.free.erase(it);
+
+            if (skipped > 0)
+                page.free[free_offset] = skipped;
+            if (free_size > skipped + size)
+                page.free[offset + size] = free_size - skipped - size;
+            return true;
+        }
+        return false;
+    };
+
+    for (int i = 0; i < int(pages_.size()); i++)
+        if (take(i))
+            return ret;
+
+    Page page;
+    page.size = std::max(page_size_, size);
+    page.mapped = nullptr;
+    page.free[0] = page.size;
+
+    glGenBuffers(1, &page.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, page.buffer);
+
+    if (persistent_)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, page.size, nullptr, flags);
+        page.mapped = static_cast<char *>(
+            glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, page.size, flags));
+        ASSERT(page.mapped, "Couldn't map a buffer page");
+    }
+    else
+    {
+        glBufferData(GL_COPY_WRITE_BUFFER, page.size, nullptr, GL_STATIC_DRAW);
+    }
+
+    log_.Debug() << "New buffer page of " << page.size << " bytes";
+
+    pages_.push_back(page);
+    take(pages_.size() - 1);
+    return ret;
+}
+
+void BufferPool::Free(Range &range)
+{
+    if (range.page >= 0)
+        retired_.emplace_back(frame_, range);
+    range = Range();
+}
+
+void BufferPool::Write(const Range &range, size_t offset, const void *data, size_t size)
+{
+    ASSERT(offset + size <= range.size);
+
+    auto &page = pages_[range.page];
+    if (page.mapped)
+    {
+        memcpy(page.mapped + range.offset + offset, data, size);
+    }
+    else
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, page.buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, range.offset + offset, size, data);
+    }
+}
+
+void BufferPool::Copy(const Range &from, const Range &to, size_t size)
+{
+    ASSERT(size <= from.size && size <= to.size);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, from.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, to.buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from.offset, to.offset,
+                        size);
+}
+
+void BufferPool::EndFrame()
+{
+    fences_.push_back({frame_, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+    frame_++;
+
+    // frames finish in order, the first unsignaled fence ends the search
+    uint64_t finished = 0;
+    while (!fences_.empty())
+    {
+        GLenum status = glClientWaitSync(fences_.front().sync, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+
+        finished = fences_.front().frame + 1;
+        glDeleteSync(fences_.front().sync);
+        fences_.pop_front();
+    }
+
+    // ranges freed during frame n can still be read by it
+    while (!retired_.empty() && retired_.front().first < finished)
+    {
+        Release(retired_.front().second);
+        retired_.pop_front();
+    }
+}
+
+void BufferPool::Release(const Range &range)
+{
+    auto &free = pages_[range.page].free;
+    auto it = free.emplace(range.offset, range.size).first;
+
+    auto next = std::next(it);
+    if (next != free.end() && it->first + it->second == next->first)
+    {
+        it->second += next->second;
+        free.erase(next);
+    }
+
+    if (it != free.begin())
+    {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second == it->first)
+        {
+            prev->second += it->second;
+            free.erase(it);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#include "collision_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+typedef void (*KernelFn)(const uint32_t *, const PieceRow *, int, const int32_t *,
+                         const int32_t *, int, uint8_t *);
+
+static void CheckRowCollisionsScalar(const uint32_t *rows, const PieceRow *piece,
+                                     int piece_rows, const int32_t *base,
+                                     const int32_t *shift, int count, uint8_t *hits)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t acc = 0;
+        for (int r = 0; r < piece_rows && !acc; r++)
+        {
+            uint32_t bits =
+                shift[i] >= 0 ? piece[r].bits << shift[i] : piece[r].bits >> -shift[i];
+            acc = rows[base[i] + piece[r].offset] & bits;
+        }
+        hits[i] = acc != 0;
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+// Eight placements per iteration: board rows are gathered per lane and the block rows
+// shifted with per-lane variable shifts, neither of which exists before AVX2.
+__attribute__((target("avx2"))) static void
+CheckRowCollisionsAVX2(const uint32_t *rows, const PieceRow *piece, int piece_rows,
+                       const int32_t *base, const int32_t *shift, int count,
+                       uint8_t *hits)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i lane_base = _mm256_loadu_si256((const __m256i *)(base + i));
+        __m256i lane_shift = _mm256_loadu_si256((const __m256i *)(shift + i));
+        __m256i left = _mm256_max_epi32(lane_shift, zero);
+        __m256i right = _mm256_max_epi32(_mm256_sub_epi32(zero, lane_shift), zero);
+        __m256i acc = zero;
+
+        for (int r = 0; r < piece_rows; r++)
+        {
+            __m256i index =
+                _mm256_add_epi32(lane_base, _mm256_set1_epi32(piece[r].offset));
+            __m256i board = _mm256_i32gather_epi32((const int *)rows, index, 4);
+            __m256i bits = _mm256_srlv_epi32(
+                _mm256_sllv_epi32(_mm256_set1_epi32(piece[r].bits), left), right);
+            acc = _mm256_or_si256(acc, _mm256_and_si256(board, bits));
+        }
+
+        int empty = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(acc, zero)));
+        for (int lane = 0; lane < 8; lane++)
+            hits[i + lane] = !((empty >> lane) & 1);
+    }
+
+    CheckRowCollisionsScalar(rows, piece, piece_rows, base + i, shift + i, count - i,
+                             hits + i);
+}
+#endif
+
+static KernelFn PickKernel(const char **name)
+{
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        *name = "avx2";
+        return CheckRowCollisionsAVX2;
+    }
+#endif
+    *name = "scalar";
+    return CheckRowCollisionsScalar;
+}
+
+static const char *kernel_name = nullptr;
+
+static KernelFn Kernel()
+{
+    static const KernelFn kernel = PickKernel(&kernel_name);
+    return kernel;
+}
+
+void CheckRowCollisions(const uint32_t *rows, const PieceRow *piece, int piece_rows,
+                        const int32_t *base, const int32_t *shift, int count,
+                        uint8_t *hits)
+{
+    Kernel()(rows, piece, piece_rows, base, shift, count, hits);
+}
+
+const char *RowCollisionKernelName()
+{
+    Kernel();
+    return kernel_name;
+}
@@ -1,6 +1,8 @@
 
 #include <boost/variant.hpp>
 #include <cmrc/cmrc.hpp>
+#include <limits>
+#include <sstream>
 
 #include "config.h"
 
@@ -57,41 +59,44 @@ void Config::Load(std::string config_path)
 void Config::Load(int argc, char **argv)
 {
     for (int arg_i = 1; arg_i < argc; arg_i++)
-    {
-        string current_argument(argv[arg_i]), current_name, current_value;
-        std::map<std::string, boost::any>::iterator param_entry;
-        unsigned int cursor = NAME_PREFIX.length();
-
-        if (NAME_PREFIX != "" && current_argument.find(NAME_PREFIX) != 0)
-        {
-            log_.Error() << "Wrong prefix on argument: " << current_argument << "!";
-            continue;
-        }
+        LoadArgument(argv[arg_i]);
+}
 
-        while (cursor < current_argument.length() &&
-               current_argument[cursor] != NAME_VALUE_SEPARATOR)
-        {
-            current_name += current_argument[cursor];
-            cursor++;
-        }
+void Config::LoadArgument(const std::string &current_argument)
+{
+    string current_name, current_value;
+    std::map<std::string, boost::any>::iterator param_entry;
+    unsigned int cursor = NAME_PREFIX.length();
 
-        if (cursor == current_argument.length())
-        {
-            log_.Error() << "No separator on argument: " << current_argument << "!";
-            continue;
-        }
+    if (NAME_PREFIX != "" && current_argument.find(NAME_PREFIX) != 0)
+    {
+        log_.Error() << "Wrong prefix on argument: " << current_argument << "!";
+        return;
+    }
 
-        if ((param_entry = params_.find(current_name)) == params_.end())
-        {
-            log_.Error() << "Argument not recognized: " << current_name << "!";
-            continue;
-        }
+    while (cursor < current_argument.length() &&
+           current_argument[cursor] != NAME_VALUE_SEPARATOR)
+    {
+        current_name += current_argument[cursor];
+        cursor++;
+    }
 
-        for (cursor += 1; cursor < current_argument.length(); cursor++)
-            current_value += current_argument[cursor];
+    if (cursor == current_argument.length())
+    {
+        log_.Error() << "No separator on argument: " << current_argument << "!";
+        return;
+    }
 
-        params_[current_name] = ParseValue(param_entry->second.type(), current_value);
+    if ((param_entry = params_.find(current_name)) == params_.end())
+    {
+        log_.Error() << "Argument not recognized: " << current_name << "!";
+        return;
     }
+
+    for (cursor += 1; cursor < current_argument.length(); cursor++)
+        current_value += current_argument[cursor];
+
+    params_[current_name] = ParseValue(param_entry->second.type(), current_value);
 }
 
 void Config::LoadXMLConfig(pugi::xml_document &doc)
@@ -127,28 +132,61 @@ void Config::LoadXMLConfig(pugi::xml_document &doc)
 
 void Config::SetParameter(std::string name, boost::any val) { params_[name] = val; }
 
-void Config::DumpSettings()
+bool Config::CheckRange(const std::string &name, int min, int max)
 {
-    for (const auto &param : params_)
+    int value = GetOption<int>(name);
+    if (value >= min && value <= max)
+        return true;
+
+    log_.Error() << "Option " << name << " is " << value << ", it has to be between "
+                 << min << " and " << max << "!";
+    return false;
+}
+
+// Shortest text that ParseValue reads back as the same value.
+template <typename T> static string ExactToString(T value)
+{
+    string ret;
+    for (int precision = 6; precision <= std::numeric_limits<T>::max_digits10; precision++)
     {
-        string value;
-        auto &type_id = param.second.type();
-        if (type_id == typeid(string))
-            value = boost::any_cast<string>(param.second);
-        if (type_id == typeid(int))
-            value = std::to_string(boost::any_cast<int>(param.second));
-        if (type_id == typeid(float))
-            value = std::to_string(boost::any_cast<float>(param.second));
-        if (type_id == typeid(double))
-            value = std::to_string(boost::any_cast<double>(param.second));
-        if (type_id == typeid(bool))
-        {
-            if (boost::any_cast<bool>(param.second))
-                value = "true";
-            else
-                value = "false";
-        }
+        std::ostringstream stream;
+        stream.precision(precision);
+        stream << value;
+        ret = stream.str();
 
-        log_.Info() << "Param \"" << param.first << "\" = " << value;
+        if (boost::any_cast<T>(ParseValue(typeid(T), ret)) == value)
+            break;
     }
-}
\ No newline at end of file
+    return ret;
+}
+
+static string ValueToString(const boost::any &value)
+{
+    auto &type_id = value.type();
+    if (type_id == typeid(string))
+        return boost::any_cast<string>(value);
+    if (type_id == typeid(int))
+        return std::to_string(boost::any_cast<int>(value));
+    if (type_id == typeid(float))
+        return ExactToString(boost::any_cast<float>(value));
+    if (type_id == typeid(double))
+        return ExactToString(boost::any_cast<double>(value));
+    if (type_id == typeid(bool))
+        return boost::any_cast<bool>(value) ? "true" : "false";
+    return "";
+}
+
+void Config::DumpSettings()
+{
+    for (const auto &param : params_)
+        log_.Info() << "Param \"" << param.first << "\" = " << ValueToString(param.second);
+}
+
+std::vector<std::string> Config::Arguments() const
+{
+    std::vector<std::string> ret;
+    for (const auto &param : params_)
+        ret.push_back(NAME_PREFIX + param.first + NAME_VALUE_SEPARATOR +
+                      ValueToString(param.second));
+    return ret;
+}
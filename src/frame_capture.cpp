@@ -0,0 +1,149 @@
+#include <cstring>
+
+#include "frame_capture.h"
+#include "profiler.h"
+
+FrameCapture::FrameCapture(const std::string &path, int width, int height, int fps)
+    : width_(width), height_(height), frame_size_(size_t(width) * height * 4),
+      next_slot_(0), dropped_(0), writer_(path, width, height, fps), allocated_frames_(0),
+      writer_stop_(false)
+{
+    for (auto &slot : slots_)
+    {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frame_size_, nullptr, GL_STREAM_READ);
+        slot.fence = nullptr;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    writer_thread_ = std::thread(&FrameCapture::RunWriter, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+    while (!in_flight_.empty())
+    {
+        int slot = in_flight_.front();
+        in_flight_.pop_front();
+        glClientWaitSync(slots_[slot].fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        Collect(slot);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(frames_mutex_);
+        writer_stop_ = true;
+    }
+    frames_cv_.notify_one();
+    writer_thread_.join();
+
+    for (auto &slot : slots_)
+        glDeleteBuffers(1, &slot.pbo);
+
+    if (dropped_)
+        log_.Warning() << dropped_ << " frames dropped from the capture";
+}
+
+void FrameCapture::Capture()
+{
+    Profiler::Scope scope("capture");
+
+    // hand over everything the GPU has finished, in order
+    while (!in_flight_.empty())
+    {
+        int slot = in_flight_.front();
+        if (glClientWaitSync(slots_[slot].fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            break;
+
+        in_flight_.pop_front();
+        Collect(slot);
+    }
+
+    if (in_flight_.size() == RING)
+    {
+        // the GPU is more than RING frames behind
+        dropped_++;
+        return;
+    }
+
+    auto &slot = slots_[next_slot_];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    in_flight_.push_back(next_slot_);
+    next_slot_ = (next_slot_ + 1) % RING;
+}
+
+void FrameCapture::Collect(int index)
+{
+    auto &slot = slots_[index];
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    std::unique_ptr<std::vector<uint8_t>> frame;
+    {
+        std::lock_guard<std::mutex> lock(frames_mutex_);
+        if (!free_frames_.empty())
+        {
+            frame = std::move(free_frames_.back());
+            free_frames_.pop_back();
+        }
+        else if (allocated_frames_ < MAX_QUEUED)
+        {
+            frame.reset(new std::vector<uint8_t>(frame_size_));
+            allocated_frames_++;
+        }
+    }
+
+    // the writer is behind
+    if (!frame)
+    {
+        dropped_++;
+        return;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    auto pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame_size_, GL_MAP_READ_BIT);
+    if (pixels)
+    {
+        memcpy(frame->data(), pixels, frame_size_);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(frames_mutex_);
+        if (pixels)
+            frames_.push_back(std::move(frame));
+        else
+            free_frames_.push_back(std::move(frame));
+    }
+    frames_cv_.notify_one();
+}
+
+void FrameCapture::RunWriter()
+{
+    while (true)
+    {
+        std::unique_ptr<std::vector<uint8_t>> frame;
+        {
+            std::unique_lock<std::mutex> lock(frames_mutex_);
+            frames_cv_.wait(lock, [&] { return writer_stop_ || !frames_.empty(); });
+
+            // the remaining frames are still written when stopping
+            if (frames_.empty())
+                return;
+
+            frame = std::move(frames_.front());
+            frames_.pop_front();
+        }
+
+        writer_.Write(frame->data());
+
+        std::lock_guard<std::mutex> lock(frames_mutex_);
+        free_frames_.push_back(std::move(frame));
+    }
+}
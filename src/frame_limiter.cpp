@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <thread>
+
+#include "frame_limiter.h"
+#include "profiler.h"
+
+using namespace std::chrono;
+
+static const auto MIN_MARGIN = microseconds(200);
+static const auto MAX_MARGIN = milliseconds(4);
+
+FrameLimiter::FrameLimiter(int fps)
+    : period_(fps > 0 ? duration_cast<Clock::duration>(duration<double>(1.0 / fps))
+                      : Clock::duration::zero()),
+      next_(Clock::now() + period_), margin_(milliseconds(1))
+{
+}
+
+void FrameLimiter::Wait()
+{
+    if (period_ == Clock::duration::zero())
+        return;
+
+    auto now = Clock::now();
+
+    // A frame that took too long doesn't make the next ones shorter.
+    if (now > next_)
+    {
+        next_ = now + period_;
+        return;
+    }
+
+    if (next_ - now > margin_)
+    {
+        auto wake = next_ - margin_;
+        std::this_thread::sleep_until(wake);
+
+        // Widen the margin right away when a sleep overshoots, narrow it slowly.
+        auto overshoot = Clock::now() - wake;
+        margin_ = std::max(overshoot * 5 / 4, margin_ - margin_ / 16);
+        margin_ = std::min(std::max(margin_, Clock::duration(MIN_MARGIN)),
+                           Clock::duration(MAX_MARGIN));
+    }
+
+    while (Clock::now() < next_)
+        std::this_thread::yield();
+
+    duration<float, std::milli> late = Clock::now() - next_;
+    Profiler::inst().Record("limiter overshoot", late.count());
+
+    next_ += period_;
+}
@@ -0,0 +1,62 @@
+#include "game_view.h"
+#include "shapes.h"
+
+GameView::GameView(Visualisation &vis) : shown_shape_(0), shown_heap_version_(0)
+{
+    // Shapes are meshed once, in white, and tinted with the color of the falling
+    // block. Rotations only change the model matrix.
+    for (int shape = 0; shape < ShapeTable::inst().Shapes(); shape++)
+    {
+        auto object = vis.CreateObject();
+        auto geometry =
+            ShapeTable::inst().Orientation(ShapeTable::inst().SpawnOrientation(shape));
+        geometry.Repaint(0xff, 0xff, 0xff);
+        object->LoadGeometry(geometry, true);
+        blocks_.push_back(object);
+    }
+
+    heap_object_ = vis.CreateObject();
+    heap_object_->SetVisibility(true);
+}
+
+void GameView::Show(const GameSnapshot &previous, const GameSnapshot &current, float alpha)
+{
+    // nothing was simulated yet
+    if (!current.heap)
+        return;
+
+    if (current.heap_version != shown_heap_version_)
+    {
+        heap_object_->LoadGeometry(*current.heap);
+        shown_heap_version_ = current.heap_version;
+    }
+
+    if (current.block_shape != shown_shape_)
+    {
+        blocks_[shown_shape_]->SetVisibility(false);
+        blocks_[shown_shape_]->SetGhost(false);
+        shown_shape_ = current.block_shape;
+    }
+
+    auto block = blocks_[current.block_shape];
+
+    glm::vec3 position = current.block_position;
+    glm::quat orientation = current.block_orientation;
+
+    // A new block jumps to its spawn position instead of flying there from the
+    // landing spot of the previous one.
+    if (previous.block_serial == current.block_serial)
+    {
+        position = glm::mix(previous.block_position, position, alpha);
+        orientation = glm::slerp(previous.block_orientation, orientation, alpha);
+    }
+
+    block->SetPostion(position);
+    block->SetOrientation(orientation);
+    block->SetColor(current.block_color);
+    block->SetVisibility(true);
+
+    // the landing height only moves in whole cells, so it is not interpolated
+    block->SetGhost(current.ghost_visible,
+                    glm::vec3(position.x, current.ghost_position.y, position.z));
+}
@@ -1,66 +1,13 @@
 
 #include "gameplay.h"
 #include "config.h"
+#include "shapes.h"
 
-// clang-format off
-static const std::vector<std::array<uint32_t, BLOCK_SIZE*BLOCK_SIZE>> tetris_shapes = {
-    {
-        0, 0, 0, 0, 0,
-        0, 0, 1, 0, 0,
-        0, 1, 1, 1, 0,
-        0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0
-    },
-    {
-        0, 0, 0, 0, 0,
-        0, 0, 1, 0, 0,
-        0, 0, 1, 0, 0,
-        0, 0, 1, 0, 0,
-        0, 0, 1, 0, 0
-    },
-    {
-        0, 0, 0, 0, 0,
-        0, 1, 1, 0, 0,
-        0, 0, 1, 0, 0,
-        0, 0, 1, 1, 0,
-        0, 0, 0, 0, 0
-    },
-    {
-        0, 0, 0, 0, 0,
-        0, 1, 1, 0, 0,
-        0, 1, 1, 0, 0,
-        0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0
-    },
-    {
-        0, 0, 0, 0, 0,
-        0, 0, 1, 0, 0,
-        0, 0, 1, 0, 0,
-        0, 0, 1, 1, 0,
-        0, 0, 0, 0, 0
-    },
-};
-
-// clang-format on
-
-static Geometry<BLOCK_SIZE, BLOCK_SIZE>
-ShapeToGeometry(const std::array<uint32_t, BLOCK_SIZE * BLOCK_SIZE> &shape)
-{
-    Geometry<BLOCK_SIZE, BLOCK_SIZE> ret;
-
-    for (int i = 0; i < BLOCK_SIZE / 2; i++)
-        ret.AddEmptyLayer();
-    ret.AddLayer(shape);
-    for (int i = 0; i < BLOCK_SIZE / 2; i++)
-        ret.AddEmptyLayer();
-
-    return ret;
-}
-
-Gameplay::Gameplay(Visualisation &vis)
-    : last_time_(0.0f), boost_on_(false), random_device_(), random_generator_(random_device_()),
-      // fixme: hardcoded stuff
-      color_distribution_(0x60, 0xA0), block_distribution_(0, tetris_shapes.size() - 1),
+Gameplay::Gameplay(uint32_t seed)
+    : heap_(Config::inst().GetOption<int>("board_size")), last_time_(0.0f), boost_on_(false),
+      random_generator_(seed),
+      color_distribution_(0, Palette::inst().BlockColors() - 1),
+      block_distribution_(0, ShapeTable::inst().Shapes() - 1),
       trajectory_movement_x_(), trajectory_movement_z_(),
       accumulated_speed_(Config::inst().GetOption<float>("initial_speed")),
       max_speed_(Config::inst().GetOption<float>("max_speed")),
@@ -69,15 +16,8 @@ Gameplay::Gameplay(Visualisation &vis)
       speed_increment_peroid_(Config::inst().GetOption<float>("speed_increment_peroid")),
       height_(Config::inst().GetOption<int>("height"))
 {
-    for (auto &shape : tetris_shapes)
-    {
-        auto geometry = ShapeToGeometry(shape);
-        auto object = vis.CreateObject();
-        object->LoadGeometry(geometry, true);
-        blocks_.emplace_back(std::make_pair(geometry, object));
-    }
-
-    heap_object_ = vis.CreateObject();
+    // The heap never grows far above the spawn height.
+    heap_.Reserve(height_ + BLOCK_SIZE);
 
     // Don't bother with collisions with virtual floot, lets use normal blocks for this.
     heap_.AddFullLayer();
@@ -85,30 +25,47 @@ Gameplay::Gameplay(Visualisation &vis)
     heap_.AddFullLayer();
 
     heap_.Repaint(0x40, 0x40, 0x40); // fixme: hardcoded stuff
-    heap_object_->LoadGeometry(heap_);
-    heap_object_->SetVisibility(true);
+    PublishHeap();
 
     InitNewFallingBlock();
+    // fills in the snapshot of the spawned block
+    Update(0.0f);
+}
+
+uint32_t Gameplay::NewSeed()
+{
+    int seed = Config::inst().GetOption<int>("seed");
+    return seed != 0 ? uint32_t(seed) : std::random_device()();
+}
+
+void Gameplay::PublishHeap()
+{
+    // Snapshots share the copy, so it must never change after this.
+    state_.heap = std::make_shared<const Board>(heap_);
+    state_.heap_version++;
 }
 
 void Gameplay::InitNewFallingBlock()
 {
-    blocks_[falling_block_.type].second->SetVisibility(false);
-    blocks_[falling_block_.type].second->ResetRotation();
+    initial_rot_ = glm::angleAxis(0.0f, glm::vec3(0.0f, 1.0f, 0.0f));
+    target_rot_ = initial_rot_;
+    current_rot_ = initial_rot_;
+    trajectory_rot_ = Trajectory(0.0f, 0.1f, 0.0f, 1.0f);
 
     falling_block_.type = block_distribution_(random_generator_);
-    log_.Info() << "Spawning new block of shape: " << falling_block_.type;
+    falling_block_.orientation_ = ShapeTable::inst().SpawnOrientation(falling_block_.type);
 
-    falling_block_.geometry_ = blocks_[falling_block_.type].first;
+    // the falling block is drawn in exactly the color it keeps in the heap
+    falling_block_.color_ = Palette::inst().BlockColor(color_distribution_(random_generator_));
+    uint32_t rgb = Palette::inst().Resolve(falling_block_.color_);
 
-    falling_block_.geometry_.Repaint(color_distribution_(random_generator_),
-                                     color_distribution_(random_generator_),
-                                     color_distribution_(random_generator_));
+    state_.block_serial++;
+    state_.block_shape = falling_block_.type;
+    state_.block_color =
+        glm::vec3(rgb & 0xff, (rgb >> 8) & 0xff, (rgb >> 16) & 0xff) / 255.0f;
 
-    blocks_[falling_block_.type].second->LoadGeometry(falling_block_.geometry_, true);
-    blocks_[falling_block_.type].second->SetVisibility(true);
-    falling_block_.target_position_x_ = BOARD_SIZE / 2 - BLOCK_SIZE / 2; // fixme
-    falling_block_.target_position_z_ = BOARD_SIZE / 2 - BLOCK_SIZE / 2; // fixme
+    falling_block_.target_position_x_ = heap_.Size() / 2 - BLOCK_SIZE / 2; // fixme
+    falling_block_.target_position_z_ = heap_.Size() / 2 - BLOCK_SIZE / 2; // fixme
 
     trajectory_movement_x_ =
         Trajectory(0.0f, 1.0f, 0.0f, falling_block_.target_position_x_);
@@ -122,9 +79,6 @@ bool Gameplay::Update(float running_time)
 {
     float delta_time = running_time - last_time_;
 
-    // For debugging
-    delta_time = std::min(delta_time, 0.0166f);
-
     if (boost_on_)
         falling_block_.height_ -= boost_speed_ * delta_time;
     else
@@ -135,151 +89,125 @@ bool Gameplay::Update(float running_time)
         accumulated_speed_ <= max_speed_)
     {
         accumulated_speed_ *= speed_increment_;
-        log_.Info() << "Increasing speed!";
+        log_.Debug() << "Increasing speed!";
     }
 
-    if (heap_.CheckCollision(falling_block_.geometry_, falling_block_.target_position_x_,
+    if (heap_.CheckCollision(FallingGeometry(), falling_block_.target_position_x_,
                              falling_block_.target_position_z_, falling_block_.height_))
     {
         if (falling_block_.height_ + 1 >= height_ - BLOCK_SIZE / 2)
         {
             log_.Info() << "Game over";
+            state_.time = running_time;
+            state_.game_over = true;
             return false;
         }
 
-        heap_.Merge(falling_block_.geometry_, falling_block_.target_position_x_,
-                    falling_block_.target_position_z_, falling_block_.height_ + 1.0f);
+        int landing_height = falling_block_.height_ + 1.0f;
+        heap_.Merge(FallingGeometry(), falling_block_.target_position_x_,
+                    falling_block_.target_position_z_, landing_height,
+                    falling_block_.color_);
 
-        for (int i = std::max(3, int(falling_block_.height_ - (BLOCK_SIZE / 2 + 1)));
-             i < int(falling_block_.height_ + (BLOCK_SIZE / 2 + 1)); i++)
-        {
-            while (heap_.CheckFullLayer(i))
-            {
-                heap_.RemoveLayer(i);
-                log_.Info() << "Layer full.";
-            }
-        }
+        // Only the layers touched by the block can get full, the floor never goes away.
+        int removed =
+            heap_.RemoveFullLayers(std::max(3, landing_height), landing_height + BLOCK_SIZE);
+        state_.layers_cleared += removed;
 
-        heap_object_->LoadGeometry(heap_);
+        PublishHeap();
         InitNewFallingBlock();
     }
 
-    blocks_[falling_block_.type].second->SetPostion(
-        glm::vec3(trajectory_movement_x_.GetPoint(running_time), falling_block_.height_,
-                  trajectory_movement_z_.GetPoint(running_time)));
+    glm::vec3 position(trajectory_movement_x_.GetPoint(running_time), falling_block_.height_,
+                       trajectory_movement_z_.GetPoint(running_time));
+    current_rot_ =
+        glm::slerp(initial_rot_, target_rot_, trajectory_rot_.GetPoint(running_time));
+
+    state_.time = running_time;
+    state_.block_position = position;
+    state_.block_orientation = current_rot_;
+    state_.block_orientation_index = falling_block_.orientation_;
+    state_.block_x = falling_block_.target_position_x_;
+    state_.block_z = falling_block_.target_position_z_;
+
+    // landing preview, hidden once the block is about to land anyway
+    int landing = LandingHeight();
+    state_.ghost_visible = landing + 1 < falling_block_.height_;
+    state_.ghost_position = glm::vec3(position.x, landing, position.z);
 
     last_time_ = running_time;
     return true;
 }
 
 // fixme: too big, move this logic somewhere lese
-void Gameplay::HandleAction(Visualisation::Action action, float running_time)
+void Gameplay::HandleAction(Action action, float running_time)
 {
     bool target_changed = false;
-    static Geometry<BLOCK_SIZE, BLOCK_SIZE> new_geometry;
 
     switch (action)
     {
-    case Visualisation::Action::MoveNorth:
+    case Action::MoveNorth:
         if (!heap_.CheckCollision(
-                falling_block_.geometry_, falling_block_.target_position_x_,
+                FallingGeometry(), falling_block_.target_position_x_,
                 falling_block_.target_position_z_ + 1, falling_block_.height_))
         {
             falling_block_.target_position_z_ += 1;
             target_changed = true;
         }
         break;
-    case Visualisation::Action::MoveSouth:
+    case Action::MoveSouth:
         if (!heap_.CheckCollision(
-                falling_block_.geometry_, falling_block_.target_position_x_,
+                FallingGeometry(), falling_block_.target_position_x_,
                 falling_block_.target_position_z_ - 1, falling_block_.height_))
         {
             falling_block_.target_position_z_ -= 1;
             target_changed = true;
         }
         break;
-    case Visualisation::Action::MoveEast:
+    case Action::MoveEast:
         if (!heap_.CheckCollision(
-                falling_block_.geometry_, falling_block_.target_position_x_ + 1,
+                FallingGeometry(), falling_block_.target_position_x_ + 1,
                 falling_block_.target_position_z_, falling_block_.height_))
         {
             falling_block_.target_position_x_ += 1;
             target_changed = true;
         }
         break;
-    case Visualisation::Action::MoveWest:
+    case Action::MoveWest:
         if (!heap_.CheckCollision(
-                falling_block_.geometry_, falling_block_.target_position_x_ - 1,
+                FallingGeometry(), falling_block_.target_position_x_ - 1,
                 falling_block_.target_position_z_, falling_block_.height_))
         {
             falling_block_.target_position_x_ -= 1;
             target_changed = true;
         }
         break;
-    case Visualisation::Action::RotatetLeft:
-        new_geometry = falling_block_.geometry_.Rotate(
-            Geometry<BLOCK_SIZE, BLOCK_SIZE>::RotationDirection::Left);
-
-        if (!heap_.CheckCollision(new_geometry, falling_block_.target_position_x_,
-                                  falling_block_.target_position_z_,
-                                  falling_block_.height_))
-        {
-            // We must be careful to always keep rotations of falling_block_.geometry_ and
-            // its Visualisation::Object* in sync
-            falling_block_.geometry_ = new_geometry;
-            blocks_[falling_block_.type].second->Rotate(
-                glm::half_pi<float>(), glm::vec3(0.0f, 1.0f, 0.0f), running_time);
-        }
-
+    case Action::RotatetLeft:
+        TryRotate(BlockGeometry::Left, glm::half_pi<float>(), glm::vec3(0.0f, 1.0f, 0.0f),
+                  running_time);
         break;
-    case Visualisation::Action::RotatetRight:
-
-        new_geometry = falling_block_.geometry_.Rotate(
-            Geometry<BLOCK_SIZE, BLOCK_SIZE>::RotationDirection::Right);
-
-        if (!heap_.CheckCollision(new_geometry, falling_block_.target_position_x_,
-                                  falling_block_.target_position_z_,
-                                  falling_block_.height_))
-        {
-            falling_block_.geometry_ = new_geometry;
-            blocks_[falling_block_.type].second->Rotate(
-                -glm::half_pi<float>(), glm::vec3(0.0f, 1.0f, 0.0f), running_time);
-        }
-
+    case Action::RotatetRight:
+        TryRotate(BlockGeometry::Right, -glm::half_pi<float>(),
+                  glm::vec3(0.0f, 1.0f, 0.0f), running_time);
         break;
-    case Visualisation::Action::RotateForward:
-        new_geometry = falling_block_.geometry_.Rotate(
-            Geometry<BLOCK_SIZE, BLOCK_SIZE>::RotationDirection::Forward);
-
-        if (!heap_.CheckCollision(new_geometry, falling_block_.target_position_x_,
-                                  falling_block_.target_position_z_,
-                                  falling_block_.height_))
-        {
-            falling_block_.geometry_ = new_geometry;
-            blocks_[falling_block_.type].second->Rotate(
-                glm::half_pi<float>(), glm::vec3(0.0f, 0.0f, 1.0f), running_time);
-        }
-
+    case Action::RotateForward:
+        TryRotate(BlockGeometry::Forward, glm::half_pi<float>(),
+                  glm::vec3(0.0f, 0.0f, 1.0f), running_time);
+        break;
+    case Action::RotateBackward:
+        TryRotate(BlockGeometry::Backward, -glm::half_pi<float>(),
+                  glm::vec3(0.0f, 0.0f, 1.0f), running_time);
         break;
-    case Visualisation::Action::RotateBackward:
-        new_geometry = falling_block_.geometry_.Rotate(
-            Geometry<BLOCK_SIZE, BLOCK_SIZE>::RotationDirection::Backward);
 
-        if (!heap_.CheckCollision(new_geometry, falling_block_.target_position_x_,
-                                  falling_block_.target_position_z_,
-                                  falling_block_.height_))
-        {
-            falling_block_.geometry_ = new_geometry;
-            blocks_[falling_block_.type].second->Rotate(
-                -glm::half_pi<float>(), glm::vec3(0.0f, 0.0f, 1.0f), running_time);
-        }
+    case Action::HardDrop:
+        // The next Update finds the block colliding right below and lands it.
+        falling_block_.height_ = LandingHeight();
         break;
 
-    case Visualisation::Action::StartBoost:
+    case Action::StartBoost:
         boost_on_ = true;
         log_.Info() << "Boost on!";
         break;
-    case Visualisation::Action::StopBoost:
+    case Action::StopBoost:
         boost_on_ = false;
         log_.Info() << "Boost off!";
         break;
@@ -296,3 +224,32 @@ void Gameplay::HandleAction(Visualisation::Action action, float running_time)
                                                 falling_block_.target_position_z_);
     }
 }
+
+int Gameplay::LandingHeight() const
+{
+    return heap_.DropHeight(FallingGeometry(), falling_block_.target_position_x_,
+                            falling_block_.target_position_z_, falling_block_.height_);
+}
+
+const BlockGeometry &Gameplay::FallingGeometry() const
+{
+    return ShapeTable::inst().Orientation(falling_block_.orientation_);
+}
+
+void Gameplay::TryRotate(BlockGeometry::RotationDirection dir, float angle, glm::vec3 axis,
+                         float running_time)
+{
+    int orientation = ShapeTable::inst().Rotate(falling_block_.orientation_, dir);
+
+    if (!heap_.CheckCollision(ShapeTable::inst().Orientation(orientation),
+                              falling_block_.target_position_x_,
+                              falling_block_.target_position_z_, falling_block_.height_))
+    {
+        // We must be careful to always keep falling_block_.orientation_ and the
+        // animated rotation in sync
+        falling_block_.orientation_ = orientation;
+        initial_rot_ = current_rot_;
+        target_rot_ = glm::angleAxis(angle, axis) * target_rot_;
+        trajectory_rot_ = Trajectory(running_time, running_time + 0.1f, 0.0f, 1.0f);
+    }
+}
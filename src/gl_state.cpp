@@ -0,0 +1,89 @@
+#include "gl_state.h"
+
+template <typename T>
+bool GlState::Changed(std::map<GLint, T> &cache, GLint location, const T &value)
+{
+    auto it = cache.find(location);
+    if (it != cache.end() && it->second == value)
+    {
+        frame_.skipped++;
+        return false;
+    }
+
+    cache[location] = value;
+    frame_.calls++;
+    return true;
+}
+
+void GlState::BindVertexArray(GLuint vao)
+{
+    if (vao == vao_)
+    {
+        frame_.skipped++;
+        return;
+    }
+
+    vao_ = vao;
+    frame_.calls++;
+    glBindVertexArray(vao);
+}
+
+void GlState::Uniform(GLint location, int value)
+{
+    if (Changed(ints_, location, value))
+        glUniform1i(location, value);
+}
+
+void GlState::Uniform(GLint location, const glm::vec3 &value)
+{
+    if (Changed(vec3s_, location, value))
+        glUniform3fv(location, 1, &value[0]);
+}
+
+void GlState::Uniform(GLint location, const glm::mat4 &value)
+{
+    if (Changed(mat4s_, location, value))
+        glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+void GlState::DrawElements(GLenum mode, GLsizei count)
+{
+    frame_.calls++;
+    frame_.draws++;
+    glDrawElements(mode, count, GL_UNSIGNED_INT, 0);
+}
+
+void GlState::DrawElementsInstanced(GLenum mode, GLsizei count, GLsizei instances)
+{
+    frame_.calls++;
+    frame_.draws++;
+    glDrawElementsInstanced(mode, count, GL_UNSIGNED_INT, 0, instances);
+}
+
+void GlState::DrawArrays(GLenum mode, GLsizei count)
+{
+    frame_.calls++;
+    frame_.draws++;
+    glDrawArrays(mode, 0, count);
+}
+
+void GlState::MultiDrawElementsIndirect(GLenum mode, const GLvoid *offset,
+                                        GLsizei commands)
+{
+    frame_.calls++;
+    frame_.draws++;
+    glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, offset, commands, 0);
+}
+
+void GlState::MultiDrawArraysIndirect(GLenum mode, const GLvoid *offset, GLsizei commands)
+{
+    frame_.calls++;
+    frame_.draws++;
+    glMultiDrawArraysIndirect(mode, offset, commands, 0);
+}
+
+void GlState::EndFrame()
+{
+    last_frame_ = frame_;
+    frame_ = Counters();
+}
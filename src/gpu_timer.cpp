@@ -0,0 +1,59 @@
+#include "gpu_timer.h"
+#include "profiler.h"
+
+GpuTimer::GpuTimer() : supported_(GLEW_ARB_timer_query) {}
+
+GpuTimer::~GpuTimer()
+{
+    for (auto &query : pending_)
+        free_.push_back(query.id);
+
+    if (!free_.empty())
+        glDeleteQueries(free_.size(), free_.data());
+}
+
+void GpuTimer::Begin(const char *name)
+{
+    if (!supported_)
+        return;
+
+    GLuint id;
+    if (free_.empty())
+    {
+        glGenQueries(1, &id);
+    }
+    else
+    {
+        id = free_.back();
+        free_.pop_back();
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, id);
+    pending_.push_back({id, name});
+}
+
+void GpuTimer::End()
+{
+    if (supported_)
+        glEndQuery(GL_TIME_ELAPSED);
+}
+
+void GpuTimer::EndFrame()
+{
+    while (!pending_.empty())
+    {
+        auto &query = pending_.front();
+
+        GLint available = 0;
+        glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &ns);
+        Profiler::inst().Record(query.name, ns / 1e6f);
+
+        free_.push_back(query.id);
+        pending_.pop_front();
+    }
+}
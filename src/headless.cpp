@@ -0,0 +1,193 @@
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "autoplayer.h"
+#include "board.h"
+#include "config.h"
+#include "gameplay.h"
+#include "log.h"
+#include "profiler.h"
+#include "replay.h"
+#include "thread_pool.h"
+
+using namespace std::chrono;
+
+// Plays batches of games without a window as fast as the CPUs allow, with random input,
+// spread over all cores. Used for simulation throughput, for checking the game rules on
+// machines with no display and for tuning the game options on many games at once.
+// With autoplay set the Autoplayer plays instead, for soak tests. With replay_file set
+// it replays that one game instead, as fast as it goes.
+
+// Outcome of one game.
+struct GameResult
+{
+    int64_t steps = 0;
+    int blocks = 0;
+    int layers = 0;
+    bool game_over = false;
+};
+
+// Plays one game with the autoplayer or, without one, with random input drawn from
+// the seed, so every game is the same from run to run.
+static GameResult PlayGame(uint32_t seed, Autoplayer *autoplayer, float step,
+                           int max_blocks)
+{
+    static const Action moves[] = {Action::MoveNorth,     Action::MoveSouth,
+                                   Action::MoveWest,      Action::MoveEast,
+                                   Action::RotateForward, Action::RotateBackward,
+                                   Action::RotatetLeft,   Action::RotatetRight,
+                                   Action::HardDrop};
+    std::mt19937 input_generator(seed);
+    std::uniform_int_distribution<> input_distribution(0, 15);
+
+    Gameplay gameplay(seed);
+
+    GameResult ret;
+    int planned_block = 0;
+    std::vector<Action> planned_actions;
+    bool running = true;
+    while (running && (!max_blocks || gameplay.State().block_serial < max_blocks))
+    {
+        float time = ++ret.steps * step;
+
+        if (autoplayer)
+        {
+            // a new block after every Update that landed one
+            if (gameplay.State().block_serial != planned_block)
+            {
+                planned_block = gameplay.State().block_serial;
+                autoplayer->Plan(gameplay.State(), planned_actions);
+                for (auto action : planned_actions)
+                    gameplay.HandleAction(action, time);
+            }
+        }
+        else
+        {
+            // 9 of 16 steps get an action, 1 of 16 a hard drop
+            int input = input_distribution(input_generator);
+            if (input < int(sizeof(moves) / sizeof(moves[0])))
+                gameplay.HandleAction(moves[input], time);
+        }
+
+        running = gameplay.Update(time);
+    }
+
+    ret.blocks = gameplay.State().block_serial;
+    ret.layers = gameplay.State().layers_cleared;
+    ret.game_over = !running;
+    return ret;
+}
+
+static int RunReplay(Replay &replay, Log &log)
+{
+    const float step = 1.0f / Config::inst().GetOption<int>("simulation_rate");
+
+    Gameplay gameplay(replay.Seed());
+
+    uint32_t steps = 0;
+    bool running = true;
+    auto start = steady_clock::now();
+    while (running && !replay.Ended(steps))
+    {
+        float time = ++steps * step;
+        replay.Apply(gameplay, steps);
+        running = gameplay.Update(time);
+    }
+
+    float elapsed = duration<float>(steady_clock::now() - start).count();
+    log.Info() << "Replayed " << steps << " steps in " << elapsed << " s";
+
+    return replay.Check(steps, gameplay.State().block_serial) ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    Log log("headless");
+
+    Config::inst().Load(argc, argv);
+
+    Replay replay;
+    auto replay_file = Config::inst().GetOption<std::string>("replay_file");
+    if (!replay_file.empty())
+    {
+        if (!replay.Load(replay_file))
+            return 1;
+        replay.ApplyOptions();
+        Config::inst().Load(argc, argv);
+    }
+
+    if (!Config::inst().CheckRange("board_size", 1, Board::MAX_SIZE))
+        return 1;
+
+    LoggingSingleton::inst().AddLogFile(
+        Config::inst().GetOption<std::string>("log_file"));
+
+    Config::inst().DumpSettings();
+
+    if (!replay_file.empty())
+        return RunReplay(replay, log);
+
+    if (!Config::inst().CheckRange("headless_games", 1, std::numeric_limits<int>::max()))
+        return 1;
+
+    const int games = Config::inst().GetOption<int>("headless_games");
+    const float step = 1.0f / Config::inst().GetOption<int>("simulation_rate");
+    // the autoplayer can keep a game going forever
+    const int max_blocks = Config::inst().GetOption<int>("headless_max_blocks");
+
+    // game n plays the pieces of seed + n
+    const uint32_t seed = Gameplay::NewSeed();
+    log.Info() << "Seed: " << seed;
+
+    ThreadPool pool(Config::inst().GetOption<int>("headless_threads"));
+
+    // One per pool thread. The games already keep every core busy, so the autoplayers
+    // only get threads of their own when there is a single game at a time.
+    std::vector<std::unique_ptr<Autoplayer>> autoplayers;
+    int autoplay_threads =
+        pool.Threads() == 1 ? Config::inst().GetOption<int>("autoplay_threads") : 1;
+    if (Config::inst().GetOption<bool>("autoplay"))
+        for (int i = 0; i < pool.Threads(); i++)
+            autoplayers.emplace_back(new Autoplayer(autoplay_threads));
+
+    std::vector<GameResult> results(games);
+    auto start = steady_clock::now();
+
+    // Game lengths vary a lot, the pool's work stealing keeps the threads busy anyway.
+    pool.ParallelFor(games, [&](int game, int thread) {
+        auto autoplayer = autoplayers.empty() ? nullptr : autoplayers[thread].get();
+        results[game] = PlayGame(seed + game, autoplayer, step, max_blocks);
+        log.Debug() << "Game " << game << " over after " << results[game].steps
+                    << " steps, " << results[game].blocks << " blocks";
+    });
+
+    float elapsed = duration<float>(steady_clock::now() - start).count();
+
+    int64_t total_steps = 0, total_blocks = 0, total_layers = 0;
+    int unfinished = 0;
+    Histogram survival(games);
+    for (const auto &result : results)
+    {
+        total_steps += result.steps;
+        total_blocks += result.blocks;
+        total_layers += result.layers;
+        unfinished += !result.game_over;
+        survival.Add(result.steps * step);
+    }
+
+    log.Info() << games << " games on " << pool.Threads() << " threads in " << elapsed
+               << " s: " << games / elapsed << " games/s, " << total_blocks / elapsed
+               << " blocks/s, " << total_steps / elapsed << " steps/s, "
+               << total_steps * step / elapsed << "x real time";
+    log.Info() << "Per game: " << float(total_blocks) / games << " blocks, "
+               << float(total_layers) / games << " layers cleared";
+    log.Info() << "Survival in s of game time: p10 " << survival.Percentile(0.1f)
+               << ", p50 " << survival.Percentile(0.5f) << ", p90 "
+               << survival.Percentile(0.9f) << ", min " << survival.Percentile(0.0f)
+               << ", max " << survival.Percentile(1.0f);
+    if (unfinished)
+        log.Info() << unfinished << " games stopped at headless_max_blocks";
+}
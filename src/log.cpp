@@ -33,17 +33,21 @@ void LoggingSingleton::AddLogFile(std::string name)
 
     file_sink->set_level(spdlog::level::trace);
 
+    std::lock_guard<std::mutex> lock(mutex_);
     sinks_.push_back(file_sink);
-    handles_.clear();
+    for (auto &handle : handles_)
+        handle.second->sinks().push_back(file_sink);
 }
 
 std::shared_ptr<spdlog::logger> LoggingSingleton::RegisterModule(std::string name)
 {
-    std::shared_ptr<spdlog::logger> ret =
-        std::make_shared<spdlog::logger>(name, std::begin(sinks_), std::end(sinks_));
-
-    ret->flush_on(spdlog::level::warn);
-    handles_.push_back(ret);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &ret = handles_[name];
+    if (!ret)
+    {
+        ret = std::make_shared<spdlog::logger>(name, std::begin(sinks_), std::end(sinks_));
+        ret->flush_on(spdlog::level::warn);
+    }
     return ret;
 }
 
@@ -51,12 +55,20 @@ LogStream::LogStream(std::shared_ptr<spdlog::logger> handle,
                      spdlog::level::level_enum level)
     : handle_(handle), level_(level)
 {
+    if (!handle_->should_log(level_))
+        stream_.setstate(std::ios::badbit);
 }
 
-LogStream::LogStream(const LogStream &oth) : handle_(oth.handle_), level_(oth.level_) {}
+LogStream::LogStream(const LogStream &oth) : handle_(oth.handle_), level_(oth.level_)
+{
+    stream_.setstate(oth.stream_.rdstate());
+}
 
 LogStream::~LogStream()
 {
+    if (!stream_)
+        return;
+
     stream_.seekg(0, stream_.end);
     if (stream_.tellg() > 0)
         handle_->log(level_, stream_.str());
@@ -66,10 +78,11 @@ Log::Log(std::string module_name) : module_(module_name) {}
 
 std::shared_ptr<spdlog::logger> Log::GetHandle() const
 {
-    auto ret = handle_.lock();
+    auto ret = std::atomic_load(&handle_);
     if (!ret)
     {
         ret = LoggingSingleton::inst().RegisterModule(module_);
+        std::atomic_store(&handle_, ret);
     }
 
     return ret;
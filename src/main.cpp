@@ -1,13 +1,18 @@
-#include <chrono>
+#include <atomic>
 #include <stdio.h>
+#include <thread>
 
+#include "board.h"
 #include "config.h"
-#include "gameplay.h"
+#include "frame_limiter.h"
+#include "game_view.h"
 #include "log.h"
+#include "profiler.h"
+#include "replay.h"
+#include "simulation.h"
 #include "visualisation.h"
 
 using std::string;
-using namespace std::chrono;
 
 int main(int argc, char **argv)
 {
@@ -16,6 +21,22 @@ int main(int argc, char **argv)
 
     Config::inst().Load(argc, argv);
 
+    // The recorded options make the game, the command line still picks the rest,
+    // e.g. the resolution.
+    Replay replay;
+    auto replay_file = Config::inst().GetOption<std::string>("replay_file");
+    bool replaying = !replay_file.empty();
+    if (replaying)
+    {
+        if (!replay.Load(replay_file))
+            return 1;
+        replay.ApplyOptions();
+        Config::inst().Load(argc, argv);
+    }
+
+    if (!Config::inst().CheckRange("board_size", 1, Board::MAX_SIZE))
+        return 1;
+
     LoggingSingleton::inst().AddLogFile(
         Config::inst().GetOption<std::string>("log_file"));
 
@@ -23,37 +44,73 @@ int main(int argc, char **argv)
 
     //====================
 
-    auto block_start_time = high_resolution_clock::now();
-
     Visualisation vis;
-    Gameplay gameplay(vis);
+    Simulation simulation(replaying ? &replay : nullptr);
 
-    bool exit_requested = false;
-    while (!exit_requested)
+    std::atomic<bool> exit_requested(false);
+
+    int max_fps = Config::inst().GetOption<int>("max_fps");
+    if (max_fps == 0 && !vis.Vsync() &&
+        Config::inst().GetOption<std::string>("present_mode") != "immediate")
     {
-        auto time = std::chrono::high_resolution_clock::now();
-        float running_time =
-            float(duration_cast<std::chrono::milliseconds>(time - block_start_time)
-                      .count()) /
-            1000.0f;
+        // vsync was asked for but isn't there, don't spin a core on frames no one sees
+        max_fps = 60;
+        log.Warning() << "Limiting the frame rate to " << max_fps << " fps";
+    }
+
+    // Rendering gets its own thread, so a swap waiting for vsync never delays input.
+    vis.ReleaseCurrent();
+    std::thread render_thread([&] {
+        vis.MakeCurrent();
+        GameView view(vis);
+        FrameLimiter limiter(max_fps);
+
+        while (!exit_requested)
+        {
+            Profiler::Scope frame_scope("frame");
+            float running_time = simulation.Now();
 
-        vis.Render(running_time);
+            simulation.Poll();
+            view.Show(simulation.Previous(), simulation.Current(),
+                      simulation.Alpha(running_time));
+
+            vis.Render(running_time);
+            limiter.Wait();
+
+            if (simulation.Current().game_over)
+                exit_requested = true;
+        }
+
+        vis.ReleaseCurrent();
+    });
+
+    // Input stays on this thread, the one that created the window.
+    while (!exit_requested)
+    {
+        vis.PollInput(simulation.Now(), 10);
 
         while (auto action = vis.DequeueAction())
         {
-            switch (*action)
+            switch (action->action)
             {
-            case Visualisation::Exit:
+            case Action::Exit:
                 exit_requested = true;
                 break;
+            case Action::ReportTimings:
+                Profiler::inst().Report();
+                break;
             default:
-                gameplay.HandleAction(*action, running_time);
+                if (replaying)
+                    break;
+                if (!simulation.PushAction(*action))
+                    log.Warning() << "Input queue full, dropping action";
             }
         }
-
-        if (!gameplay.Update(running_time))
-            exit_requested = true;
     }
 
+    render_thread.join();
+    vis.MakeCurrent();
+
+    Profiler::inst().Report();
     log.Info() << "Exit requested. Bye, bye.";
 }
\ No newline at end of file
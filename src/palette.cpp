@@ -0,0 +1,59 @@
+#include "palette.h"
+
+#include <limits>
+
+static int Distance(uint32_t a, uint32_t b)
+{
+    int ret = 0;
+    for (int shift = 0; shift < 24; shift += 8)
+    {
+        int d = int((a >> shift) & 0xff) - int((b >> shift) & 0xff);
+        ret += d * d;
+    }
+    return ret;
+}
+
+Palette::Palette() : size_(FIRST_BLOCK_COLOR + BlockColors())
+{
+    colors_.fill(0);
+
+    // the color of freshly created cells, see Geometry::AddFullLayer
+    colors_[1] = 1;
+
+    // fixme: hardcoded stuff, muted colors from 0x60 to 0xA0 in every channel
+    for (int n = 0; n < BlockColors(); n++)
+    {
+        uint32_t r = 0x60 + (n % LEVELS) * 0x40 / (LEVELS - 1);
+        uint32_t g = 0x60 + (n / LEVELS % LEVELS) * 0x40 / (LEVELS - 1);
+        uint32_t b = 0x60 + (n / LEVELS / LEVELS) * 0x40 / (LEVELS - 1);
+        colors_[BlockColor(n)] = r + (g << 8) + (b << 16);
+    }
+}
+
+uint8_t Palette::Intern(uint32_t color)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (int i = 1; i < size_; i++)
+        if (colors_[i] == color)
+            return i;
+
+    if (size_ < int(colors_.size()))
+    {
+        colors_[size_] = color;
+        return size_++;
+    }
+
+    int best = 1, best_distance = std::numeric_limits<int>::max();
+    for (int i = 1; i < size_; i++)
+    {
+        int distance = Distance(colors_[i], color);
+        if (distance < best_distance)
+        {
+            best = i;
+            best_distance = distance;
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <iomanip>
+
+#include "profiler.h"
+
+Histogram::Histogram(size_t capacity) : capacity_(capacity), next_(0)
+{
+    samples_.reserve(capacity_);
+}
+
+void Histogram::Add(float sample)
+{
+    if (samples_.size() < capacity_)
+        samples_.push_back(sample);
+    else
+        samples_[next_] = sample;
+
+    next_ = (next_ + 1) % capacity_;
+}
+
+float Histogram::Percentile(float p) const
+{
+    if (samples_.empty())
+        return 0.0f;
+
+    auto sorted = samples_;
+    auto nth = sorted.begin() + std::min(size_t(p * sorted.size()), sorted.size() - 1);
+    std::nth_element(sorted.begin(), nth, sorted.end());
+    return *nth;
+}
+
+Profiler::Scope::~Scope()
+{
+    std::chrono::duration<float, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start_;
+    Profiler::inst().Record(name_, elapsed.count());
+}
+
+void Profiler::Record(const std::string &name, float ms)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    histograms_[name].Add(ms);
+}
+
+void Profiler::Report() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto &entry : histograms_)
+    {
+        auto &histogram = entry.second;
+        log_.Info() << std::fixed << std::setprecision(3) << entry.first
+                    << ": p50 " << histogram.Percentile(0.5f) << " ms, p95 "
+                    << histogram.Percentile(0.95f) << " ms, p99 "
+                    << histogram.Percentile(0.99f) << " ms, max "
+                    << histogram.Percentile(1.0f) << " ms (" << histogram.Count()
+                    << " samples)";
+    }
+}
@@ -0,0 +1,167 @@
+#include <cstring>
+
+#include "config.h"
+#include "gameplay.h"
+#include "replay.h"
+
+static const char MAGIC[4] = {'T', '3', 'D', 'R'};
+// 2: one draw per block color instead of three
+static const uint32_t VERSION = 2;
+// action of the closing record
+static const uint8_t END = 0xff;
+
+// Little endian on every platform we build for.
+template <typename T> static void Put(std::ofstream &file, T value)
+{
+    file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T> static bool Get(std::ifstream &file, T &value)
+{
+    return bool(file.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+static uint32_t FloatBits(float value)
+{
+    uint32_t ret;
+    memcpy(&ret, &value, sizeof(ret));
+    return ret;
+}
+
+static float BitsFloat(uint32_t bits)
+{
+    float ret;
+    memcpy(&ret, &bits, sizeof(ret));
+    return ret;
+}
+
+ReplayRecorder::ReplayRecorder(const std::string &path, uint32_t seed)
+    : file_(path, std::ios::binary)
+{
+    if (!file_)
+    {
+        log_.Error() << "Couldn't open " << path;
+        return;
+    }
+
+    file_.write(MAGIC, sizeof(MAGIC));
+    Put(file_, VERSION);
+    Put(file_, seed);
+
+    auto options = Config::inst().Arguments();
+    Put(file_, uint32_t(options.size()));
+    for (auto &option : options)
+    {
+        Put(file_, uint16_t(option.size()));
+        file_.write(option.data(), option.size());
+    }
+
+    log_.Info() << "Recording the game with seed " << seed << " to " << path;
+}
+
+void ReplayRecorder::Record(uint32_t tick, const TimedAction &action)
+{
+    Put(file_, tick);
+    Put(file_, uint8_t(action.action));
+    Put(file_, FloatBits(action.time));
+}
+
+void ReplayRecorder::Finish(uint32_t tick, int blocks)
+{
+    Put(file_, tick);
+    Put(file_, END);
+    Put(file_, uint32_t(blocks));
+    file_.flush();
+
+    log_.Info() << "Recorded " << tick << " ticks, " << blocks << " blocks";
+}
+
+bool Replay::Load(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    char magic[sizeof(MAGIC)];
+    uint32_t version, options;
+    if (!file.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !Get(file, version) || version != VERSION || !Get(file, seed_) ||
+        !Get(file, options))
+    {
+        log_.Error() << "Not a replay: " << path;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < options; i++)
+    {
+        uint16_t length;
+        if (!Get(file, length))
+            return false;
+
+        std::string option(length, '\0');
+        if (!file.read(&option[0], length))
+            return false;
+        options_.push_back(option);
+    }
+
+    uint32_t tick, payload;
+    uint8_t action;
+    while (Get(file, tick) && Get(file, action) && Get(file, payload))
+    {
+        if (action == END)
+        {
+            finished_ = true;
+            end_tick_ = tick;
+            blocks_ = payload;
+            break;
+        }
+
+        // only what Gameplay::HandleAction takes, Exit and ReportTimings never get
+        // recorded
+        if (action < uint8_t(Action::MoveNorth) || action > uint8_t(Action::HardDrop))
+        {
+            log_.Error() << "Unknown action " << int(action) << " at tick " << tick
+                         << " in replay " << path;
+            return false;
+        }
+
+        entries_.push_back({tick, {Action(action), BitsFloat(payload)}});
+    }
+
+    // a game that crashed has no end record, it is replayed until game over
+    log_.Info() << "Replaying " << entries_.size() << " actions with seed " << seed_
+                << (finished_ ? "" : ", the recording wasn't finished");
+    return true;
+}
+
+void Replay::ApplyOptions() const
+{
+    for (auto &option : options_)
+        if (option.find("--record_file=") != 0 && option.find("--replay_file=") != 0)
+            Config::inst().LoadArgument(option);
+}
+
+void Replay::Apply(Gameplay &gameplay, uint32_t tick)
+{
+    for (; next_ < entries_.size() && entries_[next_].tick <= tick; next_++)
+        gameplay.HandleAction(entries_[next_].action.action, entries_[next_].action.time);
+}
+
+bool Replay::Check(uint32_t tick, int blocks) const
+{
+    if (!finished_)
+    {
+        log_.Info() << "Replay ended at tick " << tick << " with " << blocks << " blocks";
+        return true;
+    }
+
+    if (tick == end_tick_ && blocks == blocks_)
+    {
+        log_.Info() << "Replay matches the recording: " << tick << " ticks, " << blocks
+                    << " blocks";
+        return true;
+    }
+
+    log_.Error() << "Replay diverged: ended at tick " << tick << " with " << blocks
+                 << " blocks, the recording at tick " << end_tick_ << " with " << blocks_
+                 << " blocks";
+    return false;
+}
@@ -0,0 +1,106 @@
+#include "shapes.h"
+
+#include <algorithm>
+#include <queue>
+
+// clang-format off
+static const std::vector<BlockGeometry::Layer> tetris_shapes = {
+    {
+        0, 0, 0, 0, 0,
+        0, 0, 1, 0, 0,
+        0, 1, 1, 1, 0,
+        0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0
+    },
+    {
+        0, 0, 0, 0, 0,
+        0, 0, 1, 0, 0,
+        0, 0, 1, 0, 0,
+        0, 0, 1, 0, 0,
+        0, 0, 1, 0, 0
+    },
+    {
+        0, 0, 0, 0, 0,
+        0, 1, 1, 0, 0,
+        0, 0, 1, 0, 0,
+        0, 0, 1, 1, 0,
+        0, 0, 0, 0, 0
+    },
+    {
+        0, 0, 0, 0, 0,
+        0, 1, 1, 0, 0,
+        0, 1, 1, 0, 0,
+        0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0
+    },
+    {
+        0, 0, 0, 0, 0,
+        0, 0, 1, 0, 0,
+        0, 0, 1, 0, 0,
+        0, 0, 1, 1, 0,
+        0, 0, 0, 0, 0
+    },
+};
+
+// clang-format on
+
+static BlockGeometry ShapeToGeometry(const BlockGeometry::Layer &shape)
+{
+    BlockGeometry ret;
+
+    for (int i = 0; i < BLOCK_SIZE / 2; i++)
+        ret.AddEmptyLayer();
+    ret.AddLayer(shape);
+    for (int i = 0; i < BLOCK_SIZE / 2; i++)
+        ret.AddEmptyLayer();
+
+    return ret;
+}
+
+ShapeTable::ShapeTable()
+{
+    static const BlockGeometry::RotationDirection directions[] = {
+        BlockGeometry::Forward, BlockGeometry::Backward, BlockGeometry::Left,
+        BlockGeometry::Right};
+
+    for (unsigned int shape = 0; shape < tetris_shapes.size(); shape++)
+    {
+        int first = int(orientations_.size());
+        std::queue<int> pending;
+
+        orientations_.push_back(ShapeToGeometry(tetris_shapes[shape]));
+        transitions_.emplace_back();
+        shape_of_.push_back(shape);
+        pending.push(first);
+
+        // Flood fill over the rotations, every new orientation is compared with the
+        // ones already found for this shape.
+        while (!pending.empty())
+        {
+            int current = pending.front();
+            pending.pop();
+
+            for (auto dir : directions)
+            {
+                auto rotated = orientations_[current].Rotate(dir);
+                auto begin = orientations_.begin() + first;
+                auto found = std::find(begin, orientations_.end(), rotated);
+
+                if (found == orientations_.end())
+                {
+                    orientations_.push_back(rotated);
+                    transitions_.emplace_back();
+                    shape_of_.push_back(shape);
+                    pending.push(int(orientations_.size()) - 1);
+                    found = orientations_.end() - 1;
+                }
+
+                transitions_[current][dir] = int(found - orientations_.begin());
+            }
+        }
+
+        shapes_.emplace_back(first, int(orientations_.size()));
+        log_.Debug() << "Shape " << shape << " has " << orientations_.size() - first
+                     << " orientations";
+    }
+}
@@ -0,0 +1,145 @@
+#include "simulation.h"
+#include "config.h"
+#include "profiler.h"
+
+using namespace std::chrono;
+
+Simulation::Simulation(Replay *replay)
+    : step_(1.0f / Config::inst().GetOption<int>("simulation_rate")),
+      start_(steady_clock::now()), replay_(replay),
+      seed_(replay ? replay->Seed() : Gameplay::NewSeed()), gameplay_(seed_),
+      autoplayed_block_(0), stop_(false)
+{
+    log_.Info() << "Simulation step: " << step_ << "s, seed: " << seed_;
+
+    auto record_file = Config::inst().GetOption<std::string>("record_file");
+    if (!replay_ && !record_file.empty())
+        recorder_.reset(new ReplayRecorder(record_file, seed_));
+
+    int autoplay_threads = Config::inst().GetOption<int>("autoplay_threads");
+    if (!replay_ && Config::inst().GetOption<bool>("autoplay"))
+        autoplayer_.reset(new Autoplayer(autoplay_threads));
+
+    thread_ = std::thread(&Simulation::Run, this);
+}
+
+Simulation::~Simulation()
+{
+    stop_ = true;
+    thread_.join();
+}
+
+float Simulation::Now() const
+{
+    return duration<float>(steady_clock::now() - start_).count();
+}
+
+bool Simulation::PushAction(TimedAction action) { return actions_.Push(action); }
+
+void Simulation::Poll()
+{
+    if (!snapshots_.Consume())
+        return;
+
+    previous_ = current_;
+    current_ = snapshots_.Front();
+}
+
+float Simulation::Alpha(float time) const
+{
+    float span = current_.time - previous_.time;
+    if (span <= 0.0f)
+        return 1.0f;
+
+    return glm::clamp((time - step_ - previous_.time) / span, 0.0f, 1.0f);
+}
+
+void Simulation::ApplyActions(uint32_t tick, float time)
+{
+    if (replay_)
+    {
+        replay_->Apply(gameplay_, tick);
+        return;
+    }
+
+    TimedAction action;
+    while (actions_.Pop(action))
+        waiting_actions_.push_back(action);
+
+    while (!waiting_actions_.empty() && waiting_actions_.front().time <= time)
+    {
+        action = waiting_actions_.front();
+        waiting_actions_.pop_front();
+
+        gameplay_.HandleAction(action.action, action.time);
+        Profiler::inst().Record("input latency", (Now() - action.time) * 1000.0f);
+
+        if (recorder_)
+            recorder_->Record(tick, action);
+    }
+
+    if (autoplayer_ && gameplay_.State().block_serial != autoplayed_block_)
+    {
+        autoplayed_block_ = gameplay_.State().block_serial;
+
+        {
+            Profiler::Scope scope("autoplay");
+            autoplayer_->Plan(gameplay_.State(), autoplayed_actions_);
+        }
+
+        for (auto action : autoplayed_actions_)
+        {
+            // the block falls down on its own, so it can be watched
+            if (action == Action::HardDrop)
+                continue;
+
+            gameplay_.HandleAction(action, time);
+            if (recorder_)
+                recorder_->Record(tick, {action, time});
+        }
+    }
+}
+
+void Simulation::Run()
+{
+    // counted in steps, summing up step_ would drift
+    int64_t steps = 0;
+    bool running = true;
+
+    while (!stop_ && running)
+    {
+        // catch up with the wall clock, several steps at once if we were descheduled
+        bool stepped = false;
+        while (running && (steps + 1) * step_ <= Now())
+        {
+            if (replay_ && replay_->Ended(steps))
+            {
+                running = false;
+                break;
+            }
+
+            Profiler::Scope scope("update");
+            float time = ++steps * step_;
+            ApplyActions(steps, time);
+            running = gameplay_.Update(time);
+            stepped = true;
+        }
+
+        if (stepped || !running)
+        {
+            snapshots_.Back() = gameplay_.State();
+            // a replay that reached its end record ends like a lost game
+            snapshots_.Back().game_over = !running;
+            snapshots_.Publish();
+        }
+
+        auto next_step = duration<float>((steps + 1) * step_);
+        std::this_thread::sleep_until(start_ +
+                                      duration_cast<steady_clock::duration>(next_step));
+    }
+
+    if (recorder_)
+        recorder_->Finish(steps, gameplay_.State().block_serial);
+    if (replay_ && !running)
+        replay_->Check(steps, gameplay_.State().block_serial);
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
+static uint64_t Pack(int begin, int end)
+{
+    return uint64_t(uint32_t(end)) << 32 | uint32_t(begin);
+}
+
+static int Begin(uint64_t range) { return int(uint32_t(range)); }
+static int End(uint64_t range) { return int(range >> 32); }
+
+ThreadPool::ThreadPool(int threads)
+    : generation_(0), stop_(false), active_(0), job_(nullptr), chunk_(1)
+{
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    shares_.reset(new Share[threads]);
+
+    for (int i = 1; i < threads; i++)
+        workers_.emplace_back(&ThreadPool::RunWorker, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+
+    for (auto &worker : workers_)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int, int)> &f)
+{
+    if (workers_.empty() || count <= 1)
+    {
+        for (int i = 0; i < count; i++)
+            f(i, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &f;
+        // small enough to leave something to steal, large enough to keep the atomics
+        // out of short loops
+        chunk_ = std::max(1, count / (Threads() * 16));
+        for (int i = 0; i < Threads(); i++)
+            shares_[i].range = Pack(int(int64_t(count) * i / Threads()),
+                                    int(int64_t(count) * (i + 1) / Threads()));
+        active_ = int(workers_.size());
+        generation_++;
+    }
+    start_cv_.notify_all();
+
+    Work(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [&] { return active_ == 0; });
+    job_ = nullptr;
+}
+
+void ThreadPool::RunWorker(int thread)
+{
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true)
+    {
+        start_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_)
+            return;
+        seen = generation_;
+
+        lock.unlock();
+        Work(thread);
+        lock.lock();
+
+        if (--active_ == 0)
+            done_cv_.notify_one();
+    }
+}
+
+void ThreadPool::Work(int thread)
+{
+    int begin, end;
+    while (TakeOwn(thread, begin, end) || (Steal(thread) && TakeOwn(thread, begin, end)))
+    {
+        for (int i = begin; i < end; i++)
+            (*job_)(i, thread);
+    }
+}
+
+bool ThreadPool::TakeOwn(int thread, int &begin, int &end)
+{
+    auto &range = shares_[thread].range;
+    uint64_t current = range.load();
+
+    do
+    {
+        begin = Begin(current);
+        end = std::min(End(current), begin + chunk_);
+        if (begin >= end)
+            return false;
+    } while (!range.compare_exchange_weak(current, Pack(end, End(current))));
+
+    return true;
+}
+
+bool ThreadPool::Steal(int thread)
+{
+    for (int i = 1; i < Threads(); i++)
+    {
+        auto &range = shares_[(thread + i) % Threads()].range;
+        uint64_t current = range.load();
+
+        int begin, end, middle;
+        do
+        {
+            begin = Begin(current);
+            end = End(current);
+            if (begin >= end)
+                break;
+            middle = begin + (end - begin) / 2;
+        } while (!range.compare_exchange_weak(current, Pack(begin, middle)));
+
+        // Our own share is empty, thieves leave it alone until this store.
+        if (begin < end)
+        {
+            shares_[thread].range = Pack(middle, end);
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,59 @@
+#include "video_writer.h"
+
+static bool EndsWith(const std::string &str, const std::string &suffix)
+{
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+VideoWriter::VideoWriter(const std::string &path, int width, int height, int fps)
+    : width_(width), height_(height), y4m_(EndsWith(path, ".y4m")),
+      file_(path, std::ios::binary), planes_(size_t(width) * height * 3)
+{
+    if (!file_)
+    {
+        log_.Error() << "Couldn't open " << path;
+        return;
+    }
+
+    if (y4m_)
+        file_ << "YUV4MPEG2 W" << width_ << " H" << height_ << " F" << fps
+              << ":1 Ip A1:1 C444\n";
+
+    log_.Info() << "Writing " << width_ << "x" << height_ << " "
+                << (y4m_ ? "Y4M" : "raw RGB24") << " video to " << path;
+}
+
+void VideoWriter::Write(const uint8_t *rgba)
+{
+    const size_t pixels = size_t(width_) * height_;
+
+    for (int y = 0; y < height_; y++)
+    {
+        // flipped, video rows go top-down
+        const uint8_t *src = rgba + size_t(height_ - 1 - y) * width_ * 4;
+
+        for (int x = 0; x < width_; x++, src += 4)
+        {
+            size_t i = size_t(y) * width_ + x;
+            int r = src[0], g = src[1], b = src[2];
+
+            if (!y4m_)
+            {
+                planes_[i * 3] = r;
+                planes_[i * 3 + 1] = g;
+                planes_[i * 3 + 2] = b;
+                continue;
+            }
+
+            // BT.601, 8 bit fixed point
+            planes_[i] = (66 * r + 129 * g + 25 * b + 128 + (16 << 8)) >> 8;
+            planes_[pixels + i] = (-38 * r - 74 * g + 112 * b + 128 + (128 << 8)) >> 8;
+            planes_[pixels * 2 + i] = (112 * r - 94 * g - 18 * b + 128 + (128 << 8)) >> 8;
+        }
+    }
+
+    if (y4m_)
+        file_ << "FRAME\n";
+    file_.write(reinterpret_cast<const char *>(planes_.data()), planes_.size());
+}
@@ -1,17 +1,20 @@
 
 #include <SDL2/SDL.h>
+#include <algorithm>
+#include <chrono>
 
 #include "config.h"
 #include "consts.h"
+#include "profiler.h"
 #include "visualisation.h"
 
 using namespace SDL2pp;
 using std::get;
 
 // see Visualisation::camera_action_shift_
-static const std::array<Visualisation::Action, 4> movement_actions = {
-    Visualisation::Action::MoveWest, Visualisation::Action::MoveNorth,
-    Visualisation::Action::MoveEast, Visualisation::Action::MoveSouth};
+static const std::array<Action, 4> movement_actions = {
+    Action::MoveWest, Action::MoveNorth,
+    Action::MoveEast, Action::MoveSouth};
 
 Visualisation::Visualisation()
     : sdl_(SDL_INIT_VIDEO),
@@ -23,13 +26,19 @@ Visualisation::Visualisation()
                                        : 0)),
       main_context_(SDL_GL_CreateContext(window_.Get())),
       rx_(Config::inst().GetOption<int>("resx")),
-      ry_(Config::inst().GetOption<int>("resy")), camera_pos_(0, 0, 0), fov_(50.0f),
+      ry_(Config::inst().GetOption<int>("resy")),
+      board_size_(Config::inst().GetOption<int>("board_size")),
+      greedy_meshing_(Config::inst().GetOption<bool>("greedy_meshing")),
+      instanced_rendering_(Config::inst().GetOption<bool>("instanced_rendering")),
+      frames_(0), camera_pos_(0, 0, 0),
+      fov_(50.0f),
       camera_dist_(20.0f), camera_h_(35.0f), camera_angle_(0.0f),
       target_angle_(glm::quarter_pi<float>() / 2.0f),
       camera_trajectory_(0.0f, 1.0f, 0.0, target_angle_),
-      fov_trajectory_(0.0f, 1.0f, fov_ * 2.0f, fov_), camera_action_shift_(0)
+      fov_trajectory_(0.0f, 1.0f, fov_ * 2.0f, fov_), camera_action_shift_(0),
+      quad_indices_capacity_(0), mesh_worker_stop_(false)
 {
-    SDL_GL_SetSwapInterval(1);
+    SetPresentMode(Config::inst().GetOption<std::string>("present_mode"));
     SDL_GL_ResetAttributes();
 
     glewExperimental = GL_TRUE;
@@ -42,18 +51,317 @@ Visualisation::Visualisation()
     vp_id_ = glGetUniformLocation(programID, "VP");
     m_id_ = glGetUniformLocation(programID, "M");
     mode_id_ = glGetUniformLocation(programID, "mode");
+    tint_id_ = glGetUniformLocation(programID, "tint");
+    instanced_id_ = glGetUniformLocation(programID, "instanced");
+    batched_id_ = glGetUniformLocation(programID, "batched");
 
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
 
     glUseProgram(programID);
+
+    buffer_pool_.reset(new BufferPool(4 << 20));
+    gpu_timer_.reset(new GpuTimer());
+
+    auto capture_file = Config::inst().GetOption<std::string>("capture_file");
+    if (!capture_file.empty())
+    {
+        // Frames are written as they are drawn, the rate in the file is nominal.
+        int fps = Config::inst().GetOption<int>("max_fps");
+        capture_.reset(new FrameCapture(capture_file, rx_, ry_, fps > 0 ? fps : 60));
+    }
+
+    // Instances already use the base instance for themselves, so instanced rendering
+    // always draws object by object.
+    batched_rendering_ = Config::inst().GetOption<bool>("batched_rendering") &&
+                         GLEW_ARB_multi_draw_indirect && !instanced_rendering_;
+    log_.Info() << (batched_rendering_ ? "Using" : "Not using")
+                << " batched multi-draw indirect rendering";
+
+    glGenBuffers(1, &draw_data_buffer_);
+    glGenBuffers(1, &indirect_buffer_);
+
+    if (instanced_rendering_)
+    {
+        // same wall layout as Object::BuildSegment, around the origin
+        std::vector<Vertex> cube;
+        auto face = [&](glm::vec3 normal, glm::vec3 o1, glm::vec3 o2) {
+            glm::vec3 white(1, 1, 1);
+            cube.emplace_back(normal + o1 - o2, glm::vec2(1, 0), normal, white);
+            cube.emplace_back(normal - o1 + o2, glm::vec2(0, 1), normal, white);
+            cube.emplace_back(normal - o1 - o2, glm::vec2(0, 0), normal, white);
+            cube.emplace_back(normal + o1 + o2, glm::vec2(1, 1), normal, white);
+        };
+
+        const float U = 0.5;
+        glm::vec3 x(U, 0, 0), y(0, U, 0), z(0, 0, U);
+        face(-x, y, z);
+        face(x, y, z);
+        face(-y, x, z);
+        face(y, x, z);
+        face(-z, x, y);
+        face(z, x, y);
+
+        cube_range_ =
+            buffer_pool_->Allocate(cube.size() * sizeof(Vertex), sizeof(Vertex));
+        buffer_pool_->Write(cube_range_, 0, cube.data(), cube.size() * sizeof(Vertex));
+    }
+
+    // enough for a few floors of a large board without greedy meshing
+    glGenBuffers(1, &quad_indices_);
+    ReserveQuadIndices(4096);
+
+    mesh_worker_ = std::thread(&Visualisation::RunMeshWorker, this);
 }
 
 Visualisation::~Visualisation()
 {
+    capture_.reset();
+
+    {
+        std::lock_guard<std::mutex> lock(mesh_jobs_mutex_);
+        mesh_worker_stop_ = true;
+    }
+    mesh_jobs_cv_.notify_one();
+    mesh_worker_.join();
+
     // fixme: ensure everything gl-related is properly freed
     for (auto object : objects_)
         delete object;
+
+    glDeleteBuffers(1, &quad_indices_);
+    glDeleteBuffers(1, &draw_data_buffer_);
+    glDeleteBuffers(1, &indirect_buffer_);
+    for (auto &vao : batch_vaos_)
+        glDeleteVertexArrays(1, &vao.second);
+}
+
+void Visualisation::PostMeshJob(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mesh_jobs_mutex_);
+        mesh_jobs_.push(std::move(job));
+    }
+    mesh_jobs_cv_.notify_one();
+}
+
+void Visualisation::RunMeshWorker()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mesh_jobs_mutex_);
+            mesh_jobs_cv_.wait(lock,
+                               [&] { return mesh_worker_stop_ || !mesh_jobs_.empty(); });
+
+            if (mesh_worker_stop_)
+                return;
+
+            job = std::move(mesh_jobs_.front());
+            mesh_jobs_.pop();
+        }
+
+        Profiler::Scope scope("mesh");
+        job();
+    }
+}
+
+void Visualisation::ReserveQuadIndices(size_t quads)
+{
+    if (quads <= quad_indices_capacity_)
+        return;
+
+    quad_indices_capacity_ = std::max(quads, quad_indices_capacity_ * 2);
+
+    std::vector<glm::u32> indices;
+    indices.reserve(quad_indices_capacity_ * 6);
+
+    for (size_t quad = 0; quad < quad_indices_capacity_; quad++)
+        for (glm::u32 offset : {0, 1, 2, 0, 1, 3})
+            indices.push_back(quad * 4 + offset);
+
+    // not through GL_ELEMENT_ARRAY_BUFFER, that one belongs to the bound vertex array
+    glBindBuffer(GL_COPY_WRITE_BUFFER, quad_indices_);
+    glBufferData(GL_COPY_WRITE_BUFFER, sizeof(glm::u32) * indices.size(), indices.data(),
+                 GL_STATIC_DRAW);
+}
+
+glm::mat4 Visualisation::ModelMatrix(glm::vec3 pos, glm::quat orientation) const
+{
+    // (O,O,O) is center of the block
+    float O = -float(BLOCK_SIZE) / 2.0f + 0.5f;
+    glm::mat4 model = glm::mat4(1.0f);
+
+    model = glm::translate(model, -glm::vec3(O, O, O));
+
+    // center the board around the origin
+    model = glm::translate(model, pos - glm::vec3(board_size_ / 2, 0, board_size_ / 2));
+
+    model *= glm::mat4_cast(orientation);
+
+    return glm::translate(model, glm::vec3(O, O, O));
+}
+
+void Visualisation::RenderObjects()
+{
+    for (auto &obj : objects_)
+    {
+        // meshes finished by the worker since the last frame
+        obj->ApplyPendingMesh();
+
+        if (!obj->visible_ || !obj->inited_)
+            continue;
+
+        glm::quat orientation = obj->orientation_;
+
+        gl_.Uniform(m_id_, ModelMatrix(obj->pos_, orientation));
+        gl_.Uniform(tint_id_, obj->color_);
+
+        obj->Render();
+
+        if (obj->ghost_visible_)
+        {
+            gl_.Uniform(m_id_, ModelMatrix(obj->ghost_pos_, orientation));
+            obj->Render(true);
+        }
+    }
+}
+
+static void SetVertexAttributes(const BufferPool::Range &range);
+
+void Visualisation::RenderBatched()
+{
+    // Per-draw model matrix, tint and mode, read in vertex.shader through an
+    // attribute with a divisor. The base instance of every command points at its
+    // entry.
+    draw_data_.clear();
+
+    // commands grouped by the buffer page the vertices live in
+    for (auto &batch : mesh_commands_)
+        batch.second.clear();
+    for (auto &batch : marker_commands_)
+        batch.second.clear();
+
+    for (auto &obj : objects_)
+    {
+        obj->ApplyPendingMesh();
+
+        if (!obj->visible_ || !obj->inited_)
+            continue;
+
+        glm::quat orientation = obj->orientation_;
+
+        auto add = [&](glm::vec3 pos, int mode) {
+            draw_data_.push_back(
+                {ModelMatrix(pos, orientation), glm::vec4(obj->color_, mode)});
+            return GLuint(draw_data_.size() - 1);
+        };
+
+        auto add_mesh = [&](glm::vec3 pos, int mode) {
+            mesh_commands_[obj->vertex_range_.buffer].push_back(
+                {obj->indices_count_, 1, 0,
+                 GLint(obj->vertex_range_.offset / sizeof(Vertex)), add(pos, mode)});
+        };
+
+        if (obj->indices_count_)
+            add_mesh(obj->pos_, 0);
+
+        if (obj->markers_count_)
+            marker_commands_[obj->markers_range_.buffer].push_back(
+                {obj->markers_count_ * 2, 1,
+                 GLuint(obj->markers_range_.offset / sizeof(Vertex)), add(obj->pos_, 1)});
+
+        if (obj->ghost_visible_ && obj->indices_count_)
+            add_mesh(obj->ghost_pos_, 2);
+    }
+
+    if (draw_data_.empty())
+        return;
+
+    // Everything is rewritten every frame, orphaning keeps the driver from waiting
+    // for the previous one.
+    glBindBuffer(GL_ARRAY_BUFFER, draw_data_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, draw_data_.size() * sizeof(DrawData),
+                 draw_data_.data(), GL_STREAM_DRAW);
+
+    indirect_commands_.clear();
+    auto append = [&](const auto &batch) {
+        size_t offset = indirect_commands_.size();
+        auto bytes = reinterpret_cast<const char *>(batch.data());
+        indirect_commands_.insert(indirect_commands_.end(), bytes,
+                                  bytes + batch.size() * sizeof(batch[0]));
+        return (const GLvoid *)offset;
+    };
+
+    mesh_batches_.clear();
+    marker_batches_.clear();
+    for (auto &batch : mesh_commands_)
+        if (!batch.second.empty())
+            mesh_batches_.emplace_back(batch.first, append(batch.second));
+    for (auto &batch : marker_commands_)
+        if (!batch.second.empty())
+            marker_batches_.emplace_back(batch.first, append(batch.second));
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, indirect_commands_.size(),
+                 indirect_commands_.data(), GL_STREAM_DRAW);
+
+    gl_.Uniform(batched_id_, 1);
+    gl_.Uniform(instanced_id_, 0);
+
+    for (auto &batch : mesh_batches_)
+    {
+        gl_.BindVertexArray(BatchVertexArray(batch.first));
+        gl_.MultiDrawElementsIndirect(GL_TRIANGLES, batch.second,
+                                      mesh_commands_[batch.first].size());
+    }
+
+    for (auto &batch : marker_batches_)
+    {
+        gl_.BindVertexArray(BatchVertexArray(batch.first));
+        gl_.MultiDrawArraysIndirect(GL_LINES, batch.second,
+                                    marker_commands_[batch.first].size());
+    }
+
+    gl_.Uniform(batched_id_, 0);
+}
+
+GLuint Visualisation::BatchVertexArray(GLuint buffer)
+{
+    auto it = batch_vaos_.find(buffer);
+    if (it != batch_vaos_.end())
+        return it->second;
+
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    gl_.BindVertexArray(vao);
+
+    // whole page from its start, commands pick their part with the base vertex
+    BufferPool::Range page;
+    page.buffer = buffer;
+    SetVertexAttributes(page);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_indices_);
+
+    glBindBuffer(GL_ARRAY_BUFFER, draw_data_buffer_);
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(6 + column);
+        glVertexAttribPointer(
+            6 + column, 4, GL_FLOAT, GL_FALSE, sizeof(DrawData),
+            (const GLvoid *)(offsetof(DrawData, model) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(6 + column, 1);
+    }
+
+    glEnableVertexAttribArray(10);
+    glVertexAttribPointer(10, 4, GL_FLOAT, GL_FALSE, sizeof(DrawData),
+                          (const GLvoid *)offsetof(DrawData, tint));
+    glVertexAttribDivisor(10, 1);
+
+    gl_.BindVertexArray(0);
+
+    batch_vaos_[buffer] = vao;
+    return vao;
 }
 
 glm::mat4 Visualisation::UpdateCamera(float running_time)
@@ -71,74 +379,130 @@ glm::mat4 Visualisation::UpdateCamera(float running_time)
 
 bool Visualisation::Render(float running_time)
 {
-    glm::mat4 projection =
-        glm::perspective(glm::radians(fov_trajectory_.GetPoint(running_time)),
-                         float(rx_) / float(ry_), 0.1f, 10000.0f);
+    glm::mat4 vp;
+    {
+        std::lock_guard<std::mutex> lock(camera_mutex_);
+        glm::mat4 projection =
+            glm::perspective(glm::radians(fov_trajectory_.GetPoint(running_time)),
+                             float(rx_) / float(ry_), 0.1f, 10000.0f);
+        vp = projection * UpdateCamera(running_time);
+    }
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gl_.Uniform(vp_id_, vp);
 
-    glm::mat4 view = UpdateCamera(running_time);
-
-    for (auto &obj : objects_)
     {
-        if (!obj->visible_)
-            continue;
+        Profiler::Scope scope("draw submit");
+        gpu_timer_->Begin("gpu draw");
 
-        // (O,O,O) is center of the block
-        float O = -float(BLOCK_SIZE) / 2.0f + 0.5f;
-        glm::mat4 model = glm::mat4(1.0f);
+        if (batched_rendering_)
+            RenderBatched();
+        else
+            RenderObjects();
+
+        gpu_timer_->End();
+    }
 
-        model = glm::translate(model, -glm::vec3(O, O, O));
+    if (capture_)
+        capture_->Capture();
 
-        // fixme: hardcoded stuff
-        model = glm::translate(model, obj->pos_ - glm::vec3(5, 0, 5));
+    {
+        Profiler::Scope scope("swap");
+        SDL_GL_SwapWindow(window_.Get());
+    }
+    buffer_pool_->EndFrame();
+    gpu_timer_->EndFrame();
 
-        model *= glm::mat4_cast(obj->GetOrientation(running_time));
+    gl_.EndFrame();
+    if (++frames_ % 300 == 0)
+        log_.Debug() << "GL calls in the last frame: " << gl_.LastFrame().calls << " ("
+                     << gl_.LastFrame().skipped << " skipped), "
+                     << gl_.LastFrame().draws << " draws";
 
-        model = glm::translate(model, glm::vec3(O, O, O));
+    return 0;
+}
 
-        glm::mat4 vp = projection * view;
+void Visualisation::SetPresentMode(const std::string &mode)
+{
+    vsync_ = false;
 
-        glUniformMatrix4fv(vp_id_, 1, GL_FALSE, &vp[0][0]);
-        glUniformMatrix4fv(m_id_, 1, GL_FALSE, &model[0][0]);
+    if (mode == "immediate")
+    {
+        SDL_GL_SetSwapInterval(0);
+        log_.Info() << "Presenting immediately";
+        return;
+    }
 
-        obj->Render(mode_id_);
+    if (mode == "adaptive")
+    {
+        // late frames are presented right away instead of waiting another interval
+        if (SDL_GL_SetSwapInterval(-1) == 0)
+        {
+            vsync_ = true;
+            log_.Info() << "Presenting with adaptive vsync";
+            return;
+        }
+        log_.Warning() << "Adaptive vsync not supported, falling back to vsync";
+    }
+    else if (mode != "vsync")
+    {
+        log_.Warning() << "Unknown present mode " << mode << ", using vsync";
     }
 
-    SDL_GL_SwapWindow(window_.Get());
+    vsync_ = SDL_GL_SetSwapInterval(1) == 0;
+    if (vsync_)
+        log_.Info() << "Presenting with vsync";
+    else
+        log_.Warning() << "Vsync not supported: " << SDL_GetError();
+}
+
+void Visualisation::MakeCurrent() { SDL_GL_MakeCurrent(window_.Get(), main_context_); }
+
+void Visualisation::ReleaseCurrent() { SDL_GL_MakeCurrent(window_.Get(), nullptr); }
+
+void Visualisation::PollInput(float now, int timeout_ms)
+{
+    uint32_t now_ticks = SDL_GetTicks();
 
     SDL_Event event;
-    while (SDL_PollEvent(&event))
+    if (!SDL_WaitEventTimeout(&event, timeout_ms))
+        return;
+
+    Profiler::Scope scope("input");
+    do
     {
+        // SDL stamps events in milliseconds since its initialization
+        float time = now + int32_t(event.common.timestamp - now_ticks) / 1000.0f;
+
         switch (event.type)
         {
         case SDL_KEYDOWN:
-            HandleKeyDown(event.key, running_time);
+            HandleKeyDown(event.key, time);
             break;
         case SDL_KEYUP:
-            HandleKeyUp(event.key, running_time);
+            HandleKeyUp(event.key, time);
             break;
         case SDL_MOUSEBUTTONDOWN:
-            HandleMouseKeyDown(event.button, running_time);
+            HandleMouseKeyDown(event.button, time);
             break;
         }
-    }
-
-    return 0;
+    } while (SDL_PollEvent(&event));
 }
 
-void Visualisation::HandleKeyUp(SDL_KeyboardEvent key, float running_time)
+void Visualisation::HandleKeyUp(SDL_KeyboardEvent key, float time)
 {
     switch (key.keysym.sym)
     {
     case SDLK_SPACE:
-        action_queue_.push(Action::StopBoost);
+        action_queue_.push({Action::StopBoost, time});
         break;
     }
 }
 
-void Visualisation::HandleKeyDown(SDL_KeyboardEvent key, float running_time)
+void Visualisation::HandleKeyDown(SDL_KeyboardEvent key, float time)
 {
+    std::lock_guard<std::mutex> lock(camera_mutex_);
+
     switch (key.keysym.sym)
     {
     case SDLK_UP:
@@ -149,60 +513,66 @@ void Visualisation::HandleKeyDown(SDL_KeyboardEvent key, float running_time)
         break;
     case SDLK_q:
         target_angle_ = target_angle_ + glm::half_pi<float>();
-        camera_trajectory_.UpdateTrajectory(running_time + 0.5f, target_angle_);
+        camera_trajectory_.UpdateTrajectory(time + 0.5f, target_angle_);
         camera_action_shift_ += 3; // -1 =_{mod4} 3
         break;
     case SDLK_e:
         target_angle_ = target_angle_ - glm::half_pi<float>();
-        camera_trajectory_.UpdateTrajectory(running_time + 0.5f, target_angle_);
+        camera_trajectory_.UpdateTrajectory(time + 0.5f, target_angle_);
         camera_action_shift_ += 1;
         break;
     case SDLK_w:
-        action_queue_.push(Action::RotateForward);
+        action_queue_.push({Action::RotateForward, time});
         break;
     case SDLK_s:
-        action_queue_.push(Action::RotateBackward);
+        action_queue_.push({Action::RotateBackward, time});
         break;
     case SDLK_a:
-        action_queue_.push(Action::RotatetRight);
+        action_queue_.push({Action::RotatetRight, time});
         break;
     case SDLK_d:
-        action_queue_.push(Action::RotatetLeft);
+        action_queue_.push({Action::RotatetLeft, time});
         break;
     case SDLK_i:
-        action_queue_.push(movement_actions[camera_action_shift_ % 4]);
+        action_queue_.push({movement_actions[camera_action_shift_ % 4], time});
         break;
     case SDLK_k:
-        action_queue_.push(movement_actions[(camera_action_shift_ + 2) % 4]);
+        action_queue_.push({movement_actions[(camera_action_shift_ + 2) % 4], time});
         break;
     case SDLK_j:
-        action_queue_.push(movement_actions[(camera_action_shift_ + 1) % 4]);
+        action_queue_.push({movement_actions[(camera_action_shift_ + 1) % 4], time});
         break;
     case SDLK_l:
-        action_queue_.push(movement_actions[(camera_action_shift_ + 3) % 4]);
+        action_queue_.push({movement_actions[(camera_action_shift_ + 3) % 4], time});
         break;
     case SDLK_PERIOD:
         fov_ *= 1.1f;
-        fov_trajectory_.UpdateTrajectory(running_time + 0.4f, fov_);
+        fov_trajectory_.UpdateTrajectory(time + 0.4f, fov_);
         break;
     case SDLK_COMMA:
         fov_ *= 0.9f;
-        fov_trajectory_.UpdateTrajectory(running_time + 0.4f, fov_);
+        fov_trajectory_.UpdateTrajectory(time + 0.4f, fov_);
         break;
     case SDLK_SPACE:
-        action_queue_.push(Action::StartBoost);
+        action_queue_.push({Action::StartBoost, time});
+        break;
+    case SDLK_RETURN:
+        action_queue_.push({Action::HardDrop, time});
         break;
     case SDLK_ESCAPE:
-        action_queue_.push(Action::Exit);
+        action_queue_.push({Action::Exit, time});
+        break;
+    case SDLK_p:
+        action_queue_.push({Action::ReportTimings, time});
         break;
     case SDLK_PAUSE:
         break;
     }
 }
 
-void Visualisation::HandleMouseKeyDown(SDL_MouseButtonEvent key, float running_time) {}
+void Visualisation::HandleMouseKeyDown(SDL_MouseButtonEvent key, float time) {}
 
-boost::optional<Visualisation::Action> Visualisation::DequeueAction()
+boost::optional<TimedAction> Visualisation::DequeueAction()
 {
     if (action_queue_.empty())
         return boost::none;
@@ -222,208 +592,484 @@ Visualisation::Object *Visualisation::CreateObject()
 // ==================== OBJECT ====================
 
 Visualisation::Object::Object(Visualisation &vis)
-    : vis_(vis), visible_(false), pos_(),
-      target_rot_(glm::angleAxis(0.0f, glm::vec3(0, 1, 0))),
-      trajectory_rot_(0.0f, 0.1f, 0.0f, 1.0f)
+    : vis_(vis), indices_count_(0), markers_count_(0), instance_count_(0),
+      color_(1, 1, 1), visible_(false), pos_(), ghost_visible_(false), ghost_pos_(),
+      orientation_(glm::angleAxis(0.0f, glm::vec3(0, 1, 0))), inited_(false)
 {
+    glGenVertexArrays(1, &mesh_vao_);
+    glGenVertexArrays(1, &markers_vao_);
+    glGenVertexArrays(1, &instances_vao_);
 }
 
 Visualisation::Object::~Object()
 {
-    if (inited_)
-    {
-        glDeleteBuffers(1, &vertex_buffer_);
-        glDeleteBuffers(1, &index_buffer_);
-        glDeleteBuffers(1, &markers_buffer_);
-    }
+    glDeleteVertexArrays(1, &mesh_vao_);
+    glDeleteVertexArrays(1, &markers_vao_);
+    glDeleteVertexArrays(1, &instances_vao_);
+
+    vis_.buffer_pool_->Free(vertex_range_);
+    vis_.buffer_pool_->Free(markers_range_);
+    vis_.buffer_pool_->Free(instance_range_);
 }
 
 template <int W, int H>
-void Visualisation::Object::LoadGeometry(Geometry<W, H> &geometry, bool create_markers)
+void Visualisation::Object::BuildSegment(const Geometry<W, H> &geometry, int h,
+                                         Segment &segment) const
 {
-    if (inited_)
+    bool create_markers = segment.key[3];
+    bool greedy = vis_.greedy_meshing_;
+    auto &vertices = segment.vertices;
+    auto &markers = segment.markers;
+
+    vertices.clear();
+    markers.clear();
+    segment.instances.clear();
+
+    // one half-wall unit
+    // fixme: hardcoded stuff
+    const float U = 0.5;
+
+    // Places a quad of the given size (in cells) around the center, with the normal
+    // pointing from the center to the wall and o1/o2 spanning its halves. UVs are
+    // scaled with the size so the checker pattern keeps one tile per cell.
+    auto place_wall = [&](glm::vec3 center, glm::vec3 normal, glm::vec3 o1, glm::vec3 o2,
+                          glm::vec2 size, glm::vec3 color) mutable {
+        glm::vec3 wall = center + normal;
+
+        vertices.emplace_back(wall + o1 - o2, glm::vec2(size.x, 0), normal, color);
+        vertices.emplace_back(wall - o1 + o2, glm::vec2(0, size.y), normal, color);
+        vertices.emplace_back(wall - o1 - o2, glm::vec2(0, 0), normal, color);
+        vertices.emplace_back(wall + o1 + o2, size, normal, color);
+    };
+
+    auto exposed = [&](int x, int z, int layer) {
+        return x < 0 || x >= W || z < 0 || z >= H || layer < 0 ||
+               layer >= geometry.Layers() || !geometry.Element(x, z, layer);
+    };
+
+    auto to_color = [](uint8_t cell) {
+        uint32_t rgb = Palette::inst().Resolve(cell);
+        auto color = glm::vec3(float(rgb & 0xff), float((rgb >> 8) & 0xff),
+                               float((rgb >> 16) & 0xff));
+        return color / 255.0f;
+    };
+
+    if (create_markers)
     {
-        glDeleteBuffers(1, &vertex_buffer_);
-        glDeleteBuffers(1, &index_buffer_);
-        glDeleteBuffers(1, &markers_buffer_);
-    }
+        for (int x = 0; x < W; x++)
+        {
+            for (int z = 0; z < H; z++)
+            {
+                if (!geometry.Element(x, z, h))
+                    continue;
 
-    std::vector<Vertex> vertices;
-    std::vector<Vertex> markers;
-    std::vector<glm::u32> indices;
+                // if vertex.shader is in "marker" mode, the vertex with uv=(1,1)
+                // will be pulled to (x,0,z)
 
-    int vertices_counter = 0;
-    markers_count_ = 0;
+                markers.emplace_back(glm::vec3(x, 0, z), glm::vec2(0, 0), glm::vec3(),
+                                     glm::vec3(1, 1, 1));
 
-    // clang-format off
+                markers.emplace_back(glm::vec3(x, 0, z), glm::vec2(1, 1), glm::vec3(),
+                                     glm::vec3(1, 1, 1));
+            }
+        }
+    }
 
-    //fixme: explain how this works
-    auto place_wall =
-        [&](float x, float y, float z, float xt, float yt, float zt, float xo1, float yo1, float zo1, float xo2, float yo2, float zo2, glm::vec3 color) mutable {
-            vertices.emplace_back(glm::vec3(x + xt + xo1 - xo2, y + yt + yo1 - yo2, z + zt + zo1 - zo2), glm::vec2(1, 0), glm::vec3(xt, yt, zt), color);
-            vertices.emplace_back(glm::vec3(x + xt - xo1 + xo2, y + yt - yo1 + yo2, z + zt - zo1 + zo2), glm::vec2(0, 1), glm::vec3(xt, yt, zt), color);
-            vertices.emplace_back(glm::vec3(x + xt - xo1 - xo2, y + yt - yo1 - yo2, z + zt - zo1 - zo2), glm::vec2(0, 0), glm::vec3(xt, yt, zt), color);
-            vertices.emplace_back(glm::vec3(x + xt + xo1 + xo2, y + yt + yo1 + yo2, z + zt + zo1 + zo2), glm::vec2(1, 1), glm::vec3(xt, yt, zt), color);
-
-            indices.push_back(vertices_counter);
-            indices.push_back(vertices_counter + 1);
-            indices.push_back(vertices_counter + 2);
-            indices.push_back(vertices_counter);
-            indices.push_back(vertices_counter + 1);
-            indices.push_back(vertices_counter + 3);
-            vertices_counter += 4;
-        };
-    // clang-format on
+    // The six wall directions, in the order of Vertex normal indices: offset of the
+    // neighbour that hides the wall and the axes the wall spans. Walls facing along x
+    // can only be merged along z and the other way round, the ones facing along y are
+    // merged in both directions. Layers are meshed separately, so nothing is merged
+    // along y.
+    struct Direction
+    {
+        int dx, dy, dz;
+        glm::vec3 o1, o2;
+        bool merge_x, merge_z;
+    };
 
-    // one half-wall unit
-    // fixme: hardcoded stuff
-    const float U = 0.5;
+    // clang-format off
+    static const std::array<Direction, 6> directions = {{
+        {-1, 0, 0, glm::vec3(0, U, 0), glm::vec3(0, 0, U), false, true},
+        { 1, 0, 0, glm::vec3(0, U, 0), glm::vec3(0, 0, U), false, true},
+        { 0,-1, 0, glm::vec3(U, 0, 0), glm::vec3(0, 0, U), true, true},
+        { 0, 1, 0, glm::vec3(U, 0, 0), glm::vec3(0, 0, U), true, true},
+        { 0, 0,-1, glm::vec3(U, 0, 0), glm::vec3(0, U, 0), true, false},
+        { 0, 0, 1, glm::vec3(U, 0, 0), glm::vec3(0, U, 0), true, false}}};
+    // clang-format on
 
-    for (int x = 0; x < W; x++)
+    if (vis_.instanced_rendering_)
     {
-        for (int z = 0; z < H; z++)
+        for (int x = 0; x < W; x++)
         {
-            for (int h = 0; h < int(geometry.heap_.size()); h++)
+            for (int z = 0; z < H; z++)
             {
-                auto &cell = geometry.Element(x, z, h);
+                uint8_t cell = geometry.Element(x, z, h);
+                if (!cell)
+                    continue;
 
-                if (cell)
+                uint8_t hidden = 0;
+                for (int n = 0; n < int(directions.size()); n++)
                 {
-                    if (create_markers)
-                    {
-                        // if vertex.shader is in "marker" mode, the vertex with uv=(1,1)
-                        // will be pulled to (x,0,z)
-
-                        markers.emplace_back(glm::vec3(x, h, z), glm::vec2(0, 0),
-                                             glm::vec3(), glm::vec3(1, 1, 1));
-
-                        markers.emplace_back(glm::vec3(x, h, z), glm::vec2(1, 1),
-                                             glm::vec3(), glm::vec3(1, 1, 1));
-
-                        markers_count_ += 1;
-                    }
-
-                    auto color = glm::vec3(float(cell & 0xff), float((cell >> 8) & 0xff),
-                                           float((cell >> 16) & 0xff));
-                    color /= 255.0f;
-
-                    // Only create the out walls
-                    if (x - 1 < 0 || !geometry.Element(x - 1, z, h))
-                        place_wall(x, h, z, -U, 0, 0, 0, U, 0, 0, 0, U, color);
-                    if (x + 1 == W || !geometry.Element(x + 1, z, h))
-                        place_wall(x, h, z, U, 0, 0, 0, U, 0, 0, 0, U, color);
-                    if (h - 1 < 0 || !geometry.Element(x, z, h - 1))
-                        place_wall(x, h, z, 0, -U, 0, U, 0, 0, 0, 0, U, color);
-                    if (h + 1 == int(geometry.heap_.size()) ||
-                        !geometry.Element(x, z, h + 1))
-                        place_wall(x, h, z, 0, U, 0, U, 0, 0, 0, 0, U, color);
-                    if (z - 1 < 0 || !geometry.Element(x, z - 1, h))
-                        place_wall(x, h, z, 0, 0, -U, U, 0, 0, 0, U, 0, color);
-                    if (z + 1 == H || !geometry.Element(x, z + 1, h))
-                        place_wall(x, h, z, 0, 0, U, U, 0, 0, 0, U, 0, color);
+                    const auto &dir = directions[n];
+                    if (!exposed(x + dir.dx, z + dir.dz, h + dir.dy))
+                        hidden |= 1 << n;
                 }
+
+                segment.instances.emplace_back(x, z, hidden, to_color(cell));
             }
         }
+
+        return;
     }
 
-    glGenBuffers(1, &vertex_buffer_);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), &vertices[0],
-                 GL_STATIC_DRAW);
+    // palette index of the exposed wall of every cell, 0 if there is none
+    std::array<uint8_t, W * H> mask;
 
-    glGenBuffers(1, &index_buffer_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(glm::u32) * indices.size(), &indices[0],
-                 GL_STATIC_DRAW);
+    for (const auto &dir : directions)
+    {
+        glm::vec3 normal = glm::vec3(dir.dx, dir.dy, dir.dz) * U;
 
-    glGenBuffers(1, &markers_buffer_);
-    glBindBuffer(GL_ARRAY_BUFFER, markers_buffer_);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * markers.size(), &markers[0],
-                 GL_STATIC_DRAW);
+        for (int z = 0; z < H; z++)
+            for (int x = 0; x < W; x++)
+                mask[z * W + x] = exposed(x + dir.dx, z + dir.dz, h + dir.dy)
+                                      ? geometry.Element(x, z, h)
+                                      : 0;
+
+        for (int z = 0; z < H; z++)
+        {
+            for (int x = 0; x < W; x++)
+            {
+                uint8_t cell = mask[z * W + x];
+                if (!cell)
+                    continue;
+
+                // grow the wall along x first, then along z while whole rows match
+                int w = 1, d = 1;
+
+                while (greedy && dir.merge_x && x + w < W && mask[z * W + x + w] == cell)
+                    w++;
+
+                while (greedy && dir.merge_z && z + d < H &&
+                       std::all_of(mask.begin() + (z + d) * W + x,
+                                   mask.begin() + (z + d) * W + x + w,
+                                   [&](uint8_t other) { return other == cell; }))
+                    d++;
+
+                for (int i = 0; i < d; i++)
+                    std::fill_n(mask.begin() + (z + i) * W + x, w, 0);
+
+                glm::vec3 center(x + (w - 1) / 2.0f, 0, z + (d - 1) / 2.0f);
+                glm::vec3 o1 = dir.o1 * (dir.o1.x != 0 ? float(w) : 1.0f);
+                glm::vec3 o2 = dir.o2 * (dir.o2.z != 0 ? float(d) : 1.0f);
+                glm::vec2 size(dir.o1.x != 0 ? w : 1, dir.o2.z != 0 ? d : 1);
+
+                place_wall(center, normal, o1, o2, size, to_color(cell));
+            }
+        }
+    }
+}
 
-    indices_count_ = indices.size();
+template <int W, int H>
+void Visualisation::Object::LoadGeometry(const Geometry<W, H> &geometry,
+                                         bool create_markers)
+{
+    // The worker gets its own copy, the caller is free to modify the geometry right
+    // away.
+    auto snapshot = std::make_shared<Geometry<W, H>>(geometry);
+
+    vis_.PostMeshJob([this, snapshot, create_markers]() {
+        auto update = BuildMesh(*snapshot, create_markers);
+
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        if (pending_)
+            pending_->Append(std::move(update));
+        else
+            pending_ = std::move(update);
+    });
+}
+
+template <int W, int H>
+Visualisation::Object::MeshUpdate
+Visualisation::Object::BuildMesh(const Geometry<W, H> &geometry, bool create_markers)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<Segment> segments(geometry.Layers());
+
+    // Everything below first_changed keeps both its content and its place in the
+    // buffers, so only the part above it has to be uploaded again.
+    int first_changed = geometry.Layers();
+    size_t first_vertex = 0, first_marker = 0, first_instance = 0;
 
+    for (int h = 0; h < geometry.Layers(); h++)
+    {
+        auto &segment = segments[h];
+        segment.key = {{h > 0 ? geometry.LayerStamp(h - 1) : 0, geometry.LayerStamp(h),
+                        h + 1 < geometry.Layers() ? geometry.LayerStamp(h + 1) : 0,
+                        create_markers}};
+
+        // Layers shift down when one below them is removed, look around for the old
+        // segment.
+        auto old = std::find_if(segments_.begin(), segments_.end(),
+                                [&](const Segment &s) { return s.key == segment.key; });
+
+        bool in_place = old != segments_.end() && old - segments_.begin() == h;
+
+        if (old != segments_.end())
+        {
+            segment.vertices = std::move(old->vertices);
+            segment.markers = std::move(old->markers);
+            segment.instances = std::move(old->instances);
+            old->key = {{0, 0, 0, 0}};
+        }
+        else
+        {
+            BuildSegment(geometry, h, segment);
+        }
+
+        if (!in_place && first_changed == geometry.Layers())
+            first_changed = h;
+
+        if (first_changed == geometry.Layers())
+        {
+            first_vertex += segment.vertices.size();
+            first_marker += segment.markers.size();
+            first_instance += segment.instances.size();
+        }
+    }
+
+    segments_ = std::move(segments);
+
+    MeshUpdate update;
+    update.first_vertex = first_vertex;
+    update.first_marker = first_marker;
+    update.first_instance = first_instance;
+
+    for (int h = first_changed; h < geometry.Layers(); h++)
+    {
+        for (auto vertex : segments_[h].vertices)
+        {
+            vertex.Lift(h);
+            update.vertices.push_back(vertex);
+        }
+
+        for (auto marker : segments_[h].markers)
+        {
+            marker.Lift(h);
+            update.markers.push_back(marker);
+        }
+
+        for (auto instance : segments_[h].instances)
+        {
+            instance.Lift(h);
+            update.instances.push_back(instance);
+        }
+    }
+
+    vis_.log_.Debug() << "Built mesh: " << first_vertex + update.vertices.size()
+                      << " vertices, " << first_instance + update.instances.size()
+                      << " instances, "
+                      << update.vertices.size() + update.instances.size()
+                      << " to upload, in "
+                      << std::chrono::duration<float, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count()
+                      << " ms";
+
+    return update;
+}
+
+void Visualisation::Object::MeshUpdate::Append(MeshUpdate &&newer)
+{
+    // The newer update was built on top of this one, its unchanged prefix is either
+    // already uploaded or still in our tail.
+    auto append = [](auto &tail, size_t &first, auto &newer_tail, size_t newer_first) {
+        if (newer_first < first)
+        {
+            tail = std::move(newer_tail);
+            first = newer_first;
+            return;
+        }
+
+        tail.erase(tail.begin() + (newer_first - first), tail.end());
+        tail.insert(tail.end(), newer_tail.begin(), newer_tail.end());
+    };
+
+    append(vertices, first_vertex, newer.vertices, newer.first_vertex);
+    append(markers, first_marker, newer.markers, newer.first_marker);
+    append(instances, first_instance, newer.instances, newer.first_instance);
+}
+
+void Visualisation::Object::ApplyPendingMesh()
+{
+    boost::optional<MeshUpdate> update;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        std::swap(update, pending_);
+    }
+
+    if (!update)
+        return;
+
+    // Ranges the GPU may still read from are never written, every update goes to a
+    // new range and the unchanged prefix is copied over on the GPU side. Ranges grow
+    // to twice the needed size, so a growing heap doesn't reallocate on every landing.
+    auto upload = [&](BufferPool::Range &range, const auto &tail, size_t first) {
+        auto &pool = *vis_.buffer_pool_;
+        const size_t element = sizeof(tail[0]);
+        size_t count = first + tail.size();
+        size_t size = count * element;
+
+        auto updated = pool.Allocate(size > range.size ? size * 2 : range.size, element);
+
+        if (first > 0)
+            pool.Copy(range, updated, first * element);
+
+        if (!tail.empty())
+            pool.Write(updated, first * element, tail.data(), tail.size() * element);
+
+        pool.Free(range);
+        range = updated;
+        return count;
+    };
+
+    size_t vertices = upload(vertex_range_, update->vertices, update->first_vertex);
+    size_t markers = upload(markers_range_, update->markers, update->first_marker);
+    size_t instances =
+        upload(instance_range_, update->instances, update->first_instance);
+
+    vis_.ReserveQuadIndices(vertices / 4);
+
+    indices_count_ = vertices / 4 * 6;
+    markers_count_ = markers / 2;
+    instance_count_ = instances;
     inited_ = true;
+
+    BuildVertexArrays();
 }
 
 void Visualisation::Object::SetVisibility(bool v) { visible_ = v; }
 
+void Visualisation::Object::SetColor(glm::vec3 color) { color_ = color; }
+
 void Visualisation::Object::SetPostion(glm::vec3 pos) { pos_ = pos; }
 
-void Visualisation::Object::ResetRotation()
+void Visualisation::Object::SetGhost(bool visible, glm::vec3 pos)
 {
-    initial_rot_ = glm::angleAxis(0.0f, glm::vec3(0.0f, 1.0f, 0.0f));
-    target_rot_ = initial_rot_;
+    ghost_visible_ = visible;
+    ghost_pos_ = pos;
 }
 
-void Visualisation::Object::Rotate(float angle, glm::vec3 axis, float running_time)
+void Visualisation::Object::SetOrientation(glm::quat orientation)
 {
-    initial_rot_ = current_rot_;
-    target_rot_ = glm::angleAxis(angle, axis) * target_rot_;
-    trajectory_rot_ = Trajectory(running_time, running_time + 0.1f, 0.0f, 1.0f);
+    orientation_ = orientation;
 }
 
-glm::quat Visualisation::Object::GetOrientation(float running_time)
+// Layout of the packed Vertex, see vertex.shader.
+static void SetVertexAttributes(const BufferPool::Range &range)
 {
-    current_rot_ =
-        glm::slerp(initial_rot_, target_rot_, trajectory_rot_.GetPoint(running_time));
-    return current_rot_;
+    glBindBuffer(GL_ARRAY_BUFFER, range.buffer);
+
+    for (GLuint attribute = 0; attribute < 4; attribute++)
+        glEnableVertexAttribArray(attribute);
+
+    glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, sizeof(Vertex),
+                          (const GLvoid *)(range.offset + offsetof(Vertex, pos_)));
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(Vertex),
+                          (const GLvoid *)(range.offset + offsetof(Vertex, tex_)));
+    glVertexAttribPointer(2, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                          (const GLvoid *)(range.offset + offsetof(Vertex, diffuse_)));
+    glVertexAttribPointer(3, 1, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(Vertex),
+                          (const GLvoid *)(range.offset + offsetof(Vertex, norm_)));
 }
 
-void Visualisation::Object::Render(GLuint mode_id)
+void Visualisation::Object::BuildVertexArrays()
 {
-    ASSERT(inited_);
+    auto &gl = vis_.gl_;
 
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-    glEnableVertexAttribArray(3);
+    if (indices_count_)
+    {
+        gl.BindVertexArray(mesh_vao_);
+        SetVertexAttributes(vertex_range_);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vis_.quad_indices_);
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    if (markers_count_)
+    {
+        gl.BindVertexArray(markers_vao_);
+        SetVertexAttributes(markers_range_);
+    }
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (const GLvoid *)offsetof(Vertex, pos_));
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (const GLvoid *)offsetof(Vertex, tex_));
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (const GLvoid *)offsetof(Vertex, diffuse_));
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (const GLvoid *)offsetof(Vertex, norm_));
+    // every cell is the same cube, moved and colored by its Instance
+    if (instance_count_)
+    {
+        gl.BindVertexArray(instances_vao_);
+        SetVertexAttributes(vis_.cube_range_);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vis_.quad_indices_);
+
+        glEnableVertexAttribArray(4);
+        glEnableVertexAttribArray(5);
+
+        glBindBuffer(GL_ARRAY_BUFFER, instance_range_.buffer);
+        glVertexAttribPointer(
+            4, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(Instance),
+            (const GLvoid *)(instance_range_.offset + offsetof(Instance, pos_)));
+        glVertexAttribPointer(
+            5, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance),
+            (const GLvoid *)(instance_range_.offset + offsetof(Instance, diffuse_)));
+        glVertexAttribDivisor(4, 1);
+        glVertexAttribDivisor(5, 1);
+    }
+
+    gl.BindVertexArray(0);
+}
+
+void Visualisation::Object::Render(bool ghost)
+{
+    ASSERT(inited_);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+    auto &gl = vis_.gl_;
 
     // marker mode off
-    glUniform1i(mode_id, false);
+    gl.Uniform(vis_.mode_id_, ghost ? 2 : 0);
 
-    glDrawElements(GL_TRIANGLES, indices_count_, GL_UNSIGNED_INT, 0);
+    if (instance_count_)
+    {
+        gl.BindVertexArray(instances_vao_);
+        gl.Uniform(vis_.instanced_id_, 1);
 
-    glBindBuffer(GL_ARRAY_BUFFER, markers_buffer_);
+        // six quads
+        gl.DrawElementsInstanced(GL_TRIANGLES, 36, instance_count_);
+    }
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (const GLvoid *)offsetof(Vertex, pos_));
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (const GLvoid *)offsetof(Vertex, tex_));
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (const GLvoid *)offsetof(Vertex, diffuse_));
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (const GLvoid *)offsetof(Vertex, norm_));
+    // empty meshes don't get a range at all
+    if (indices_count_)
+    {
+        gl.BindVertexArray(mesh_vao_);
+        gl.Uniform(vis_.instanced_id_, 0);
+        gl.DrawElements(GL_TRIANGLES, indices_count_);
+    }
+
+    if (ghost || !markers_count_)
+        return;
+
+    gl.BindVertexArray(markers_vao_);
 
     // marker mode on
-    glUniform1i(mode_id, true);
+    gl.Uniform(vis_.mode_id_, 1);
+    gl.Uniform(vis_.instanced_id_, 0);
 
-    glDrawArrays(GL_LINES, 0, markers_count_ * 2);
+    gl.DrawArrays(GL_LINES, markers_count_ * 2);
+}
 
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    glDisableVertexAttribArray(2);
-    glDisableVertexAttribArray(3);
+// Instantiates LoadGeometry for every Board specialization.
+void Visualisation::Object::LoadGeometry(const Board &board, bool create_markers)
+{
+    board.Visit([&](const auto &geometry) { LoadGeometry(geometry, create_markers); });
 }
 
 // Explicitly instantiate LoadGeometry to avoid writing its logic in the header
 // file.
 template void
-Visualisation::Object::LoadGeometry(Geometry<BOARD_SIZE, BOARD_SIZE> &geometry,
-                                    bool create_markers);
-template void
-Visualisation::Object::LoadGeometry(Geometry<BLOCK_SIZE, BLOCK_SIZE> &geometry,
+Visualisation::Object::LoadGeometry(const Geometry<BLOCK_SIZE, BLOCK_SIZE> &geometry,
                                     bool create_markers);
\ No newline at end of file
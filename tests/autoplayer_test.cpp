@@ -0,0 +1,51 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Autoplayer"
+
+#include <boost/test/unit_test.hpp>
+
+#include "autoplayer.h"
+
+static const float STEP = 1.0f / 120;
+
+// Lets the autoplayer place `blocks` blocks, returns the actions it took.
+static std::vector<Action> Play(Autoplayer &autoplayer, int blocks)
+{
+    Gameplay gameplay(42);
+    std::vector<Action> ret;
+
+    int steps = 0, planned = 0;
+    bool running = true;
+    std::vector<Action> actions;
+    while (running && gameplay.State().block_serial <= blocks)
+    {
+        float time = ++steps * STEP;
+        if (gameplay.State().block_serial != planned)
+        {
+            planned = gameplay.State().block_serial;
+            autoplayer.Plan(gameplay.State(), actions);
+            BOOST_REQUIRE(!actions.empty());
+            BOOST_CHECK(actions.back() == Action::HardDrop);
+
+            for (auto action : actions)
+                gameplay.HandleAction(action, time);
+            ret.insert(ret.end(), actions.begin(), actions.end());
+        }
+        running = gameplay.Update(time);
+    }
+
+    BOOST_CHECK(running);
+    return ret;
+}
+
+BOOST_AUTO_TEST_CASE(KeepsTheGameGoing)
+{
+    Autoplayer autoplayer(1);
+    Play(autoplayer, 200);
+}
+
+BOOST_AUTO_TEST_CASE(ThreadsDontChangeTheMoves)
+{
+    Autoplayer single(1);
+    Autoplayer pool(4);
+    BOOST_CHECK(Play(single, 50) == Play(pool, 50));
+}
@@ -0,0 +1,33 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "FrameLimiter"
+
+#include <boost/test/unit_test.hpp>
+
+#include "frame_limiter.h"
+
+using namespace std::chrono;
+
+BOOST_AUTO_TEST_CASE(HoldsTheTargetRate)
+{
+    FrameLimiter limiter(200);
+
+    auto start = steady_clock::now();
+    for (int frame = 0; frame < 20; frame++)
+        limiter.Wait();
+    auto elapsed = steady_clock::now() - start;
+
+    // 20 frames of 5 ms, the first one started with the limiter
+    BOOST_CHECK(elapsed >= milliseconds(99));
+    BOOST_CHECK(elapsed < milliseconds(500));
+}
+
+BOOST_AUTO_TEST_CASE(ZeroRateDoesntWait)
+{
+    FrameLimiter limiter(0);
+
+    auto start = steady_clock::now();
+    for (int frame = 0; frame < 1000; frame++)
+        limiter.Wait();
+
+    BOOST_CHECK(steady_clock::now() - start < milliseconds(50));
+}
@@ -0,0 +1,278 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Geometry"
+
+#include <boost/test/unit_test.hpp>
+
+#include "board.h"
+#include "consts.h"
+#include "geometry.h"
+#include "shapes.h"
+
+static const int BOARD_SIZE = 10;
+
+typedef Geometry<BOARD_SIZE, BOARD_SIZE> HeapGeometry;
+typedef Geometry<BLOCK_SIZE, BLOCK_SIZE> Block;
+
+static Block MakeBar()
+{
+    Block ret;
+    for (int h = 0; h < BLOCK_SIZE; h++)
+        ret.AddEmptyLayer();
+    for (int x = 1; x < 4; x++)
+        ret.SetElement(x, 2, 2, 7);
+    return ret;
+}
+
+BOOST_AUTO_TEST_CASE(CollisionWithWallsAndFloor)
+{
+    HeapGeometry board;
+    board.AddFullLayer();
+    auto bar = MakeBar();
+
+    BOOST_CHECK(!board.CheckCollision(bar, 0, 0, 0));
+    BOOST_CHECK(!board.CheckCollision(bar, 0, 0, -1));
+    BOOST_CHECK(board.CheckCollision(bar, 0, 0, -2));
+    BOOST_CHECK(board.CheckCollision(bar, 0, 0, -3));
+
+    BOOST_CHECK(!board.CheckCollision(bar, -1, 0, 0));
+    BOOST_CHECK(board.CheckCollision(bar, -2, 0, 0));
+    BOOST_CHECK(!board.CheckCollision(bar, BOARD_SIZE - 4, 0, 0));
+    BOOST_CHECK(board.CheckCollision(bar, BOARD_SIZE - 3, 0, 0));
+    BOOST_CHECK(!board.CheckCollision(bar, 0, -2, 0));
+    BOOST_CHECK(board.CheckCollision(bar, 0, -3, 0));
+    BOOST_CHECK(board.CheckCollision(bar, 0, BOARD_SIZE - 2, 0));
+}
+
+BOOST_AUTO_TEST_CASE(MergeAndFullLayer)
+{
+    HeapGeometry board;
+    board.AddFullLayer();
+    auto bar = MakeBar();
+
+    BOOST_CHECK(!board.CheckFullLayer(1));
+
+    // the bar lies in the layer 2 of the block, fill the layer 1 of the board with it
+    for (int z = 0; z < BOARD_SIZE; z++)
+        for (int x = -1; x < BOARD_SIZE; x += 3)
+            board.Merge(bar, x, z - 2, -1);
+
+    BOOST_CHECK_EQUAL(board.Layers(), 2);
+    BOOST_CHECK_EQUAL(int(board.Element(0, 0, 1)), 7);
+    BOOST_CHECK(board.CheckFullLayer(0));
+    BOOST_CHECK(board.CheckFullLayer(1));
+    BOOST_CHECK(board.CheckCollision(bar, 0, 0, -1));
+
+    board.RemoveLayer(1);
+    BOOST_CHECK(!board.CheckCollision(bar, 0, 0, -1));
+}
+
+BOOST_AUTO_TEST_CASE(RotationKeepsOccupancy)
+{
+    HeapGeometry board;
+    board.AddFullLayer();
+    board.AddEmptyLayer();
+    board.SetElement(2, 5, 1, 1);
+
+    auto bar = MakeBar().Rotate(Block::Left);
+
+    BOOST_CHECK_EQUAL(bar.Row(1, 2), 1u << 2);
+    BOOST_CHECK(!board.CheckCollision(bar, 0, 0, -1));
+    BOOST_CHECK(board.CheckCollision(bar, 0, 2, -1));
+}
+
+BOOST_AUTO_TEST_CASE(BatchedCollisionsMatchSingleQueries)
+{
+    HeapGeometry board;
+    board.AddFullLayer();
+    for (int h = 1; h < 6; h++)
+    {
+        board.AddEmptyLayer();
+        for (int i = 0; i < BOARD_SIZE * BOARD_SIZE; i++)
+            if ((i * 7 + h * 13) % 5 == 0)
+                board.SetElement(i % BOARD_SIZE, i / BOARD_SIZE, h, 1);
+    }
+
+    std::vector<Block> blocks = {MakeBar(), MakeBar().Rotate(Block::Forward),
+                                 MakeBar().Rotate(Block::Left)};
+
+    std::vector<Placement> placements;
+    for (int o = 0; o < int(blocks.size()); o++)
+        for (int h = -4; h < 8; h++)
+            for (int x = -4; x < BOARD_SIZE; x++)
+                for (int z = -4; z < BOARD_SIZE; z++)
+                    placements.push_back({x, z, h, o});
+
+    auto hits = board.CheckCollisions(blocks, placements);
+
+    for (unsigned int i = 0; i < placements.size(); i++)
+    {
+        const auto &p = placements[i];
+        bool hit = (hits[i / 64] >> (i % 64)) & 1;
+        BOOST_CHECK_EQUAL(hit, board.CheckCollision(blocks[p.orientation], p.x, p.z,
+                                                     p.height));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ShapeTableTransitionsAreConsistent)
+{
+    auto &table = ShapeTable::inst();
+    BOOST_CHECK(table.Shapes() > 0);
+
+    for (int shape = 0; shape < table.Shapes(); shape++)
+    {
+        auto range = table.OrientationRange(shape);
+        for (int o = range.first; o < range.second; o++)
+        {
+            BOOST_CHECK_EQUAL(table.Shape(o), shape);
+            BOOST_CHECK_EQUAL(table.Rotate(table.Rotate(o, Block::Left), Block::Right), o);
+            BOOST_CHECK_EQUAL(
+                table.Rotate(table.Rotate(o, Block::Forward), Block::Backward), o);
+            BOOST_CHECK(table.Orientation(table.Rotate(o, Block::Forward)) ==
+                        table.Orientation(o).Rotate(Block::Forward));
+
+            for (int other = range.first; other < o; other++)
+                BOOST_CHECK(!(table.Orientation(other) == table.Orientation(o)));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(RemoveFullLayersCompactsInOnePass)
+{
+    HeapGeometry board;
+    board.AddFullLayer();
+    board.AddEmptyLayer();
+    board.AddFullLayer();
+    board.AddFullLayer();
+    board.AddEmptyLayer();
+    board.SetElement(1, 1, 1, 5);
+    board.SetElement(2, 2, 4, 6);
+
+    BOOST_CHECK_EQUAL(board.RemoveFullLayers(1, 4), 2);
+    BOOST_CHECK_EQUAL(board.Layers(), 3);
+    BOOST_CHECK(board.CheckFullLayer(0));
+    BOOST_CHECK_EQUAL(int(board.Element(1, 1, 1)), 5);
+    BOOST_CHECK_EQUAL(int(board.Element(2, 2, 2)), 6);
+
+    // freed slots are reused
+    board.AddEmptyLayer();
+    BOOST_CHECK_EQUAL(board.Layers(), 4);
+    BOOST_CHECK(!board.CheckFullLayer(3));
+    BOOST_CHECK_EQUAL(board.Row(0, 3), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(ColumnHeightsAndDropHeight)
+{
+    HeapGeometry board;
+    board.AddFullLayer();
+    board.AddFullLayer();
+    auto bar = MakeBar();
+
+    BOOST_CHECK_EQUAL(board.ColumnHeight(3, 3), 2);
+    BOOST_CHECK_EQUAL(board.DropHeight(bar, 0, 0, 10), 0);
+
+    board.Merge(bar, 2, 1, 0);
+    BOOST_CHECK_EQUAL(board.ColumnHeight(3, 3), 3);
+    BOOST_CHECK_EQUAL(board.ColumnHeight(2, 3), 2);
+    BOOST_CHECK_EQUAL(board.DropHeight(bar, 1, 1, 10), 1);
+    BOOST_CHECK_EQUAL(board.DropHeight(bar, 1, 0, 10), 0);
+
+    board.SetElement(3, 3, 2, 0);
+    BOOST_CHECK_EQUAL(board.ColumnHeight(3, 3), 2);
+    board.SetElement(3, 3, 2, 1);
+
+    // overhang: the bar slid below the cell at (4, 3, 6) stays below it
+    board.Merge(bar, 3, 1, 4);
+    BOOST_CHECK_EQUAL(board.ColumnHeight(5, 3), 7);
+    BOOST_CHECK_EQUAL(board.DropHeight(bar, 3, 1, 3), 1);
+    BOOST_CHECK(!board.CheckCollision(bar, 3, 1, 1));
+    BOOST_CHECK(board.CheckCollision(bar, 3, 1, 0));
+
+    BOOST_CHECK_EQUAL(board.RemoveFullLayers(0, 2), 2);
+    BOOST_CHECK_EQUAL(board.ColumnHeight(3, 3), 1);
+    BOOST_CHECK_EQUAL(board.ColumnHeight(5, 3), 5);
+    BOOST_CHECK_EQUAL(board.ColumnHeight(0, 0), 0);
+
+    board.RemoveLayer(0);
+    BOOST_CHECK_EQUAL(board.ColumnHeight(3, 3), 0);
+    BOOST_CHECK_EQUAL(board.ColumnHeight(5, 3), 4);
+}
+
+BOOST_AUTO_TEST_CASE(RepaintGoesThroughThePalette)
+{
+    auto bar = MakeBar();
+    bar.Repaint(0x10, 0x20, 0x30);
+
+    uint8_t index = bar.Element(1, 2, 2);
+    BOOST_CHECK(index > 1);
+    BOOST_CHECK_EQUAL(Palette::inst().Resolve(index), Block::PackColor(0x10, 0x20, 0x30));
+    BOOST_CHECK_EQUAL(int(Palette::inst().Intern(0x302010)), int(index));
+    BOOST_CHECK_EQUAL(int(bar.Element(0, 2, 2)), 0);
+}
+
+BOOST_AUTO_TEST_CASE(BlockColorsArePreset)
+{
+    auto &palette = Palette::inst();
+    BOOST_CHECK(palette.BlockColors() > 0);
+    BOOST_CHECK(palette.BlockColors() < palette.Size());
+
+    // interning a block color finds it instead of adding it again
+    uint8_t last = palette.BlockColor(palette.BlockColors() - 1);
+    BOOST_CHECK_EQUAL(int(palette.Intern(palette.Resolve(last))), int(last));
+    BOOST_CHECK_EQUAL(palette.Resolve(palette.BlockColor(0)), Block::PackColor(0x60, 0x60, 0x60));
+}
+
+BOOST_AUTO_TEST_CASE(BoardSizesWithoutSpecializationUseReducedExtent)
+{
+    for (int size : {6, 7, 10, 13})
+    {
+        Board board(size);
+        board.AddFullLayer();
+        BOOST_CHECK(board.CheckFullLayer(0));
+
+        auto bar = MakeBar();
+        BOOST_CHECK(!board.CheckCollision(bar, size - 4, size - 3, 0));
+        BOOST_CHECK(board.CheckCollision(bar, size - 3, 0, 0));
+        BOOST_CHECK(board.CheckCollision(bar, 0, size - 2, 0));
+
+        for (int z = 0; z < size; z++)
+            for (int x = -1; x < size; x += 3)
+                board.Merge(bar, x, z - 2, -1, 1);
+
+        BOOST_CHECK(board.CheckFullLayer(1));
+        BOOST_CHECK_EQUAL(board.RemoveFullLayers(0, 2), 2);
+        BOOST_CHECK_EQUAL(board.Layers(), 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(LayerStampsFollowLayerContent)
+{
+    HeapGeometry board;
+    board.AddFullLayer();
+    board.AddEmptyLayer();
+    board.AddEmptyLayer();
+
+    auto full = board.LayerStamp(0), empty = board.LayerStamp(1), top = board.LayerStamp(2);
+    BOOST_CHECK(full != empty && empty != top);
+
+    board.Merge(MakeBar(), 0, 0, -1);
+    BOOST_CHECK_EQUAL(board.LayerStamp(0), full);
+    BOOST_CHECK(board.LayerStamp(1) != empty);
+    BOOST_CHECK_EQUAL(board.LayerStamp(2), top);
+
+    // copies share stamps, removed layers take theirs along
+    auto copy = board;
+    BOOST_CHECK_EQUAL(copy.LayerStamp(1), board.LayerStamp(1));
+
+    board.RemoveLayer(0);
+    BOOST_CHECK_EQUAL(board.LayerStamp(0), copy.LayerStamp(1));
+    BOOST_CHECK_EQUAL(board.LayerStamp(1), top);
+
+    // the same change on both sides of a copy still gives different stamps
+    board.SetElement(0, 0, 1, 1);
+    copy.SetElement(0, 0, 2, 2);
+    BOOST_CHECK(board.LayerStamp(1) != copy.LayerStamp(2));
+    copy = board;
+    copy.SetElement(1, 0, 1, 1);
+    board.SetElement(1, 0, 1, 2);
+    BOOST_CHECK(board.LayerStamp(1) != copy.LayerStamp(1));
+}
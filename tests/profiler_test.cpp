@@ -0,0 +1,30 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Profiler"
+
+#include <boost/test/unit_test.hpp>
+
+#include "profiler.h"
+
+BOOST_AUTO_TEST_CASE(PercentilesOfKeptSamples)
+{
+    Histogram histogram(100);
+    BOOST_CHECK_EQUAL(histogram.Percentile(0.5f), 0.0f);
+
+    for (int i = 100; i > 0; i--)
+        histogram.Add(i);
+
+    BOOST_CHECK_EQUAL(histogram.Count(), 100u);
+    BOOST_CHECK_EQUAL(histogram.Percentile(0.0f), 1.0f);
+    BOOST_CHECK_EQUAL(histogram.Percentile(0.5f), 51.0f);
+    BOOST_CHECK_EQUAL(histogram.Percentile(0.99f), 100.0f);
+    BOOST_CHECK_EQUAL(histogram.Percentile(1.0f), 100.0f);
+
+    // the oldest samples are dropped first
+    for (int i = 0; i < 50; i++)
+        histogram.Add(1000.0f);
+
+    BOOST_CHECK_EQUAL(histogram.Count(), 100u);
+    BOOST_CHECK_EQUAL(histogram.Percentile(0.0f), 1.0f);
+    BOOST_CHECK_EQUAL(histogram.Percentile(0.49f), 50.0f);
+    BOOST_CHECK_EQUAL(histogram.Percentile(0.5f), 1000.0f);
+}
@@ -0,0 +1,87 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "Replay"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "gameplay.h"
+#include "replay.h"
+
+static const float STEP = 1.0f / 120;
+
+// Plays until game over, dropping a block every 10th step, and returns the steps.
+static uint32_t Play(Gameplay &gameplay, ReplayRecorder *recorder, Replay *replay)
+{
+    uint32_t steps = 0;
+    bool running = true;
+    while (running)
+    {
+        float time = ++steps * STEP;
+        if (replay)
+            replay->Apply(gameplay, steps);
+        else if (steps % 10 == 0)
+        {
+            TimedAction action{steps % 20 ? Action::MoveEast : Action::HardDrop, time};
+            gameplay.HandleAction(action.action, action.time);
+            recorder->Record(steps, action);
+        }
+        running = gameplay.Update(time);
+    }
+    return steps;
+}
+
+BOOST_AUTO_TEST_CASE(ReplayedGameEndsLikeTheRecording)
+{
+    auto path = (boost::filesystem::temp_directory_path() /
+                 boost::filesystem::unique_path("%%%%%%.t3dr"))
+                    .string();
+
+    uint32_t steps;
+    int blocks;
+    {
+        ReplayRecorder recorder(path, 1234);
+        Gameplay gameplay(1234);
+        steps = Play(gameplay, &recorder, nullptr);
+        blocks = gameplay.State().block_serial;
+        recorder.Finish(steps, blocks);
+    }
+
+    Replay replay;
+    BOOST_REQUIRE(replay.Load(path));
+    boost::filesystem::remove(path);
+    BOOST_CHECK_EQUAL(replay.Seed(), 1234u);
+    BOOST_CHECK(replay.Ended(steps));
+    BOOST_CHECK(!replay.Ended(steps - 1));
+
+    Gameplay gameplay(replay.Seed());
+    BOOST_CHECK_EQUAL(Play(gameplay, nullptr, &replay), steps);
+    BOOST_CHECK_EQUAL(gameplay.State().block_serial, blocks);
+    BOOST_CHECK(replay.Check(steps, blocks));
+    BOOST_CHECK(!replay.Check(steps, blocks + 1));
+}
+
+BOOST_AUTO_TEST_CASE(RejectsOtherFiles)
+{
+    Replay replay;
+    BOOST_CHECK(!replay.Load("/nonexistent/replay.t3dr"));
+}
+
+BOOST_AUTO_TEST_CASE(RejectsUnknownActions)
+{
+    for (auto action : {Action::Exit, Action::ReportTimings, Action(200)})
+    {
+        auto path = (boost::filesystem::temp_directory_path() /
+                     boost::filesystem::unique_path("%%%%%%.t3dr"))
+                        .string();
+        {
+            ReplayRecorder recorder(path, 1234);
+            recorder.Record(1, {Action::MoveEast, STEP});
+            recorder.Record(2, {action, 2 * STEP});
+            recorder.Finish(3, 1);
+        }
+
+        Replay replay;
+        BOOST_CHECK(!replay.Load(path));
+        boost::filesystem::remove(path);
+    }
+}
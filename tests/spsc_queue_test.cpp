@@ -0,0 +1,55 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "SpscQueue"
+
+#include <boost/test/unit_test.hpp>
+
+#include "spsc_queue.h"
+
+#include <thread>
+
+BOOST_AUTO_TEST_CASE(BoundedFifo)
+{
+    SpscQueue<int, 4> queue;
+    int value = 0;
+    BOOST_CHECK(!queue.Pop(value));
+
+    BOOST_CHECK(queue.Push(1));
+    BOOST_CHECK(queue.Push(2));
+    BOOST_CHECK(queue.Push(3));
+    BOOST_CHECK(!queue.Push(4));
+
+    BOOST_CHECK(queue.Pop(value));
+    BOOST_CHECK_EQUAL(value, 1);
+    BOOST_CHECK(queue.Push(4));
+
+    for (int expected : {2, 3, 4})
+    {
+        BOOST_CHECK(queue.Pop(value));
+        BOOST_CHECK_EQUAL(value, expected);
+    }
+    BOOST_CHECK(!queue.Pop(value));
+}
+
+BOOST_AUTO_TEST_CASE(EveryValueArrivesInOrder)
+{
+    SpscQueue<int, 64> queue;
+    const int count = 100000;
+
+    std::thread producer([&] {
+        for (int i = 1; i <= count; i++)
+            while (!queue.Push(i))
+                std::this_thread::yield();
+    });
+
+    int value, last = 0;
+    while (last != count)
+    {
+        if (!queue.Pop(value))
+            continue;
+
+        BOOST_REQUIRE_EQUAL(value, last + 1);
+        last = value;
+    }
+
+    producer.join();
+}
@@ -0,0 +1,58 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "ThreadPool"
+
+#include <boost/test/unit_test.hpp>
+
+#include "thread_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+BOOST_AUTO_TEST_CASE(EveryIndexRunsOnce)
+{
+    ThreadPool pool(4);
+    BOOST_CHECK_EQUAL(pool.Threads(), 4);
+
+    for (int count : {0, 1, 3, 1000})
+    {
+        std::vector<std::atomic<int>> runs(count);
+        std::atomic<bool> bad_thread(false);
+
+        pool.ParallelFor(count, [&](int i, int thread) {
+            runs[i]++;
+            if (thread < 0 || thread >= pool.Threads())
+                bad_thread = true;
+        });
+
+        for (auto &run : runs)
+            BOOST_CHECK_EQUAL(run.load(), 1);
+        BOOST_CHECK(!bad_thread);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SingleThreadRunsInline)
+{
+    ThreadPool pool(1);
+    BOOST_CHECK_EQUAL(pool.Threads(), 1);
+
+    int sum = 0;
+    pool.ParallelFor(100, [&](int i, int thread) { sum += i + thread; });
+    BOOST_CHECK_EQUAL(sum, 4950);
+}
+
+BOOST_AUTO_TEST_CASE(UnevenWorkRunsOnce)
+{
+    ThreadPool pool(3);
+
+    // all the work is in the share of the first thread, the others have to steal it
+    std::vector<std::atomic<int>> runs(300);
+    pool.ParallelFor(int(runs.size()), [&](int i, int) {
+        if (i < 100)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        runs[i]++;
+    });
+
+    for (auto &run : runs)
+        BOOST_CHECK_EQUAL(run.load(), 1);
+}
@@ -0,0 +1,62 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "TripleBuffer"
+
+#include <boost/test/unit_test.hpp>
+
+#include "triple_buffer.h"
+
+#include <thread>
+
+BOOST_AUTO_TEST_CASE(ReaderGetsTheLatestPublishedValue)
+{
+    TripleBuffer<int> buffer;
+    BOOST_CHECK(!buffer.Consume());
+
+    buffer.Back() = 1;
+    buffer.Publish();
+    buffer.Back() = 2;
+    buffer.Publish();
+
+    BOOST_CHECK(buffer.Consume());
+    BOOST_CHECK_EQUAL(buffer.Front(), 2);
+    BOOST_CHECK(!buffer.Consume());
+    BOOST_CHECK_EQUAL(buffer.Front(), 2);
+
+    buffer.Back() = 3;
+    buffer.Publish();
+    BOOST_CHECK(buffer.Consume());
+    BOOST_CHECK_EQUAL(buffer.Front(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(ValuesAreNeverTornOrOutOfOrder)
+{
+    struct Pair
+    {
+        int a = 0, b = 0;
+    };
+    TripleBuffer<Pair> buffer;
+    const int count = 100000;
+
+    std::thread writer([&] {
+        for (int i = 1; i <= count; i++)
+        {
+            buffer.Back().a = i;
+            buffer.Back().b = -i;
+            buffer.Publish();
+        }
+    });
+
+    int last = 0;
+    while (last != count)
+    {
+        if (!buffer.Consume())
+            continue;
+
+        auto value = buffer.Front();
+        BOOST_REQUIRE_EQUAL(value.a, -value.b);
+        BOOST_REQUIRE(value.a > last);
+        last = value.a;
+    }
+
+    writer.join();
+}
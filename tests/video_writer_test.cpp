@@ -0,0 +1,71 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "VideoWriter"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "video_writer.h"
+
+#include <fstream>
+#include <iterator>
+
+static std::string ReadFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), {});
+}
+
+// 2x2 frame: white and black on the bottom row, red and blue on the top row
+static const uint8_t frame[] = {0xff, 0xff, 0xff, 0xff, 0, 0, 0, 0xff,
+                                0xff, 0,    0,    0xff, 0, 0, 0xff, 0xff};
+
+BOOST_AUTO_TEST_CASE(Y4mFramesArePlanarAndTopDown)
+{
+    auto path = (boost::filesystem::temp_directory_path() /
+                 boost::filesystem::unique_path("%%%%%%.y4m"))
+                    .string();
+    {
+        VideoWriter writer(path, 2, 2, 30);
+        BOOST_REQUIRE(writer.Good());
+        writer.Write(frame);
+        writer.Write(frame);
+    }
+
+    auto data = ReadFile(path);
+    boost::filesystem::remove(path);
+
+    std::string header = "YUV4MPEG2 W2 H2 F30:1 Ip A1:1 C444\n";
+    BOOST_REQUIRE_EQUAL(data.size(), header.size() + 2 * (6 + 12));
+    BOOST_CHECK_EQUAL(data.substr(0, header.size()), header);
+    BOOST_CHECK_EQUAL(data.substr(header.size(), 6), "FRAME\n");
+
+    auto planes = reinterpret_cast<const uint8_t *>(data.data()) + header.size() + 6;
+    // luma: red, blue, white, black
+    BOOST_CHECK_EQUAL(int(planes[0]), 82);
+    BOOST_CHECK_EQUAL(int(planes[1]), 41);
+    BOOST_CHECK_EQUAL(int(planes[2]), 235);
+    BOOST_CHECK_EQUAL(int(planes[3]), 16);
+    // chroma of white and black is neutral
+    BOOST_CHECK_EQUAL(int(planes[4 + 2]), 128);
+    BOOST_CHECK_EQUAL(int(planes[8 + 3]), 128);
+}
+
+BOOST_AUTO_TEST_CASE(RawFramesAreRgb)
+{
+    auto path = (boost::filesystem::temp_directory_path() /
+                 boost::filesystem::unique_path("%%%%%%.rgb"))
+                    .string();
+    {
+        VideoWriter writer(path, 2, 2, 30);
+        writer.Write(frame);
+    }
+
+    auto data = ReadFile(path);
+    boost::filesystem::remove(path);
+
+    BOOST_REQUIRE_EQUAL(data.size(), 12u);
+    BOOST_CHECK_EQUAL(int(uint8_t(data[0])), 0xff);
+    BOOST_CHECK_EQUAL(int(uint8_t(data[1])), 0);
+    BOOST_CHECK_EQUAL(int(uint8_t(data[5])), 0xff);
+    BOOST_CHECK_EQUAL(int(uint8_t(data[6])), 0xff);
+}